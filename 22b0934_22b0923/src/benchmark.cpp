@@ -108,6 +108,15 @@ namespace Stockfish {
 // bench 64 1 100000 default nodes  : search default positions for 100K nodes each
 // bench 64 4 5000 current movetime : search current position with 4 threads for 5 sec
 // bench 16 1 5 blah perft          : run a perft 5 on positions in file "blah"
+//
+// Extra flags after the limit type, in any order, are handled by UCI::bench():
+//
+// json  : print a machine-readable report of the run on stdout, and nothing else,
+//         e.g. bench 16 1 13 default depth json
+// perf  : read the hardware performance counters of the search threads and add
+//         them to the summary (and to the json report)
+// fixed : run the list as fixed work per thread, every thread searching all the
+//         positions on its own with a private hash, see UCI::fixed_bench()
 std::vector<std::string> setup_bench(const Position& current, std::istream& is) {
 
     std::vector<std::string> fens, list;
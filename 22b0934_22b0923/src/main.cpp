@@ -16,7 +16,9 @@
   along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include <algorithm>
 #include <iostream>
+#include <string>
 
 #include "bitboard.h"
 #include "misc.h"
@@ -29,7 +31,11 @@ using namespace Stockfish;
 
 int main(int argc, char* argv[]) {
 
-    std::cout << engine_info() << std::endl;
+    // A bench json report must be all there is on stdout
+    bool json = std::any_of(argv + 1, argv + argc,
+                            [](const char* a) { return std::string(a) == "json"; });
+
+    (json ? std::cerr : std::cout) << engine_info() << std::endl;
 
     Bitboards::init();
     Position::init();
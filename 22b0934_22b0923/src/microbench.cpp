@@ -0,0 +1,310 @@
+/*
+  Stockfish, a UCI chess playing engine derived from Glaurung 2.1
+  Copyright (C) 2004-2024 The Stockfish developers (see AUTHORS file)
+
+  Stockfish is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Stockfish is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "microbench.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <deque>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "benchmark.h"
+#include "misc.h"
+#include "movegen.h"
+#include "movepick.h"
+#include "nnue/network.h"
+#include "position.h"
+#include "syzygy/tbprobe.h"
+#include "tt.h"
+#include "types.h"
+
+namespace Stockfish {
+
+namespace {
+
+// A bench position with its root StateInfo, and the keys and legal moves from it
+struct Sample {
+    Position          pos;
+    StateInfo         st;
+    std::vector<Move> moves;
+    std::vector<Key>  keys;
+};
+
+// Histories for the MovePicker, all zero so that every run scores the same
+struct Histories {
+    ButterflyHistory      mainHistory;
+    CapturePieceToHistory captureHistory;
+    PieceToHistory        contHistory;
+    PawnHistory           pawnHistory;
+};
+
+using Clock = std::chrono::steady_clock;
+
+// Results are accumulated here, so that the compiler can't drop the timed code
+uint64_t Sink;
+
+// Calls 'pass', which does one pass over the positions and returns the number
+// of operations it performed, until 'duration' has elapsed. This is repeated
+// 'repetitions' times after a first warmup run, and the min, median, mean and
+// standard deviation of the cost in ns/op over the repetitions are printed.
+template<typename Pass>
+void run(const std::string& name, int repetitions, Clock::duration duration, Pass pass) {
+
+    std::vector<double> samples;
+
+    for (int r = 0; r <= repetitions; ++r)
+    {
+        uint64_t        ops   = 0;
+        Clock::duration elapsed;
+        auto            start = Clock::now();
+
+        do
+            ops += pass();
+        while ((elapsed = Clock::now() - start) < duration);
+
+        if (!ops)
+        {
+            sync_cout << std::left << std::setw(36) << name << std::right << std::setw(10) << "n/a"
+                      << sync_endl;
+            return;
+        }
+
+        if (r > 0)
+            samples.push_back(
+              double(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count()) / ops);
+    }
+
+    std::sort(samples.begin(), samples.end());
+
+    double mean = 0, var = 0;
+
+    for (double s : samples)
+        mean += s / samples.size();
+
+    for (double s : samples)
+        var += (s - mean) * (s - mean) / samples.size();
+
+    sync_cout << std::left << std::setw(36) << name << std::right << std::fixed
+              << std::setprecision(1) << std::setw(10) << samples.front() << std::setw(10)
+              << samples[samples.size() / 2] << std::setw(10) << mean << std::setw(10)
+              << std::sqrt(var) << sync_endl;
+}
+
+// Marks the accumulators of the given StateInfo as not computed, so that the
+// next evaluation has to refresh them from scratch.
+void reset_accumulators(StateInfo& st) {
+
+    for (Color c : {WHITE, BLACK})
+        st.accumulatorBig.computed[c] = st.accumulatorBig.computedPSQT[c] =
+          st.accumulatorSmall.computed[c] = st.accumulatorSmall.computedPSQT[c] = false;
+}
+
+// Times the refresh of the accumulators, their incremental update after a move
+// (including do_move() and undo_move()), and the evaluation with already
+// computed accumulators for each output bucket, which is mostly the cost of
+// the propagation through the layers of the given network.
+template<typename Network>
+void bench_network(const std::string&  name,
+                   const Network&      net,
+                   std::deque<Sample>& samples,
+                   int                 repetitions,
+                   Clock::duration     duration) {
+
+    run("nnue " + name + " refresh", repetitions, duration, [&]() {
+        for (Sample& s : samples)
+        {
+            reset_accumulators(s.st);
+            Sink += net.evaluate(s.pos);
+        }
+        return samples.size();
+    });
+
+    run("nnue " + name + " incremental (+do/undo)", repetitions, duration, [&]() {
+        StateInfo st;
+        uint64_t  ops = 0;
+
+        for (Sample& s : samples)
+            for (Move m : s.moves)
+            {
+                s.pos.do_move(m, st);
+                Sink += net.evaluate(s.pos);
+                s.pos.undo_move(m);
+                ++ops;
+            }
+        return ops;
+    });
+
+    for (Eval::NNUE::IndexType bucket = 0; bucket < Eval::NNUE::LayerStacks; ++bucket)
+    {
+        std::vector<Sample*> inBucket;
+
+        for (Sample& s : samples)
+            if (Eval::NNUE::IndexType(s.pos.count<ALL_PIECES>() - 1) / 4 == bucket)
+            {
+                Sink += net.evaluate(s.pos);  // Compute the accumulators
+                inBucket.push_back(&s);
+            }
+
+        if (!inBucket.empty())
+            run("nnue " + name + " propagate bucket " + std::to_string(bucket), repetitions,
+                duration, [&]() {
+                    for (Sample* s : inBucket)
+                        Sink += net.evaluate(s->pos);
+                    return inBucket.size();
+                });
+    }
+}
+
+}  // namespace
+
+void microbench(const Position&             current,
+                std::istream&               args,
+                const Eval::NNUE::Networks& networks,
+                const TranspositionTable&   tt) {
+
+    std::string token;
+    int         repetitions = (args >> token) ? std::max(1, std::atoi(token.c_str())) : 5;
+    int         ms          = (args >> token) ? std::max(1, std::atoi(token.c_str())) : 200;
+    std::string fenFile     = (args >> token) ? token : "default";
+
+    const Clock::duration duration = std::chrono::milliseconds(ms);
+
+    // Reuse the parsing of bench, the list has the "position fen" commands
+    std::istringstream       benchArgs("16 1 1 " + fenFile + " depth");
+    std::vector<std::string> list = setup_bench(current, benchArgs);
+    std::deque<Sample>       samples;
+    bool                     chess960 = false;
+
+    for (const std::string& cmd : list)
+        if (cmd.find("setoption name UCI_Chess960 value ") == 0)
+            chess960 = cmd.find("true") != std::string::npos;
+
+        else if (cmd.find("position fen ") == 0)
+        {
+            Sample& s = samples.emplace_back();
+            s.pos.set(cmd.substr(13), chess960, &s.st);
+
+            for (const auto& m : MoveList<LEGAL>(s.pos))
+            {
+                s.moves.push_back(m);
+                s.keys.push_back(s.pos.key_after(m));
+            }
+        }
+
+    sync_cout << "Positions: " << samples.size() << ", repetitions: " << repetitions << " x "
+              << ms << " ms\n\n"
+              << std::left << std::setw(36) << "primitive" << std::right << std::setw(10) << "min"
+              << std::setw(10) << "median" << std::setw(10) << "mean" << std::setw(10) << "stdev"
+              << "  (ns/op)" << sync_endl;
+
+    run("generate<LEGAL>", repetitions, duration, [&]() {
+        for (Sample& s : samples)
+            Sink += MoveList<LEGAL>(s.pos).size();
+        return samples.size();
+    });
+
+    run("generate<CAPTURES>", repetitions, duration, [&]() {
+        uint64_t ops = 0;
+
+        for (Sample& s : samples)
+            if (!s.pos.checkers())
+                Sink += MoveList<CAPTURES>(s.pos).size(), ++ops;
+        return ops;
+    });
+
+    run("do_move + undo_move", repetitions, duration, [&]() {
+        StateInfo st;
+        uint64_t  ops = 0;
+
+        for (Sample& s : samples)
+            for (Move m : s.moves)
+            {
+                s.pos.do_move(m, st);
+                s.pos.undo_move(m);
+                ++ops;
+            }
+        return ops;
+    });
+
+    run("see_ge", repetitions, duration, [&]() {
+        uint64_t ops = 0;
+
+        for (Sample& s : samples)
+            for (Move m : s.moves)
+                Sink += s.pos.see_ge(m, 0), ++ops;
+        return ops;
+    });
+
+    run("TranspositionTable::probe", repetitions, duration, [&]() {
+        uint64_t ops = 0;
+        bool     found;
+
+        for (Sample& s : samples)
+            for (Key k : s.keys)
+            {
+                Sink += tt.probe(k, found)->depth() + found;
+                ++ops;
+            }
+        return ops;
+    });
+
+    bench_network("big", networks.big, samples, repetitions, duration);
+    bench_network("small", networks.small, samples, repetitions, duration);
+
+    auto                  histories  = std::make_unique<Histories>();
+    const Move            killers[2] = {Move::none(), Move::none()};
+    const PieceToHistory* contHist[]  = {&histories->contHistory, &histories->contHistory,
+                                         &histories->contHistory, &histories->contHistory,
+                                         &histories->contHistory, &histories->contHistory};
+
+    run("MovePicker full iteration", repetitions, duration, [&]() {
+        for (Sample& s : samples)
+        {
+            MovePicker mp(s.pos, Move::none(), 10, &histories->mainHistory,
+                          &histories->captureHistory, contHist, &histories->pawnHistory,
+                          Move::none(), killers);
+
+            while (mp.next_move() != Move::none())
+                ++Sink;
+        }
+        return samples.size();
+    });
+
+    run("Tablebases::probe_wdl", repetitions, duration, [&]() {
+        uint64_t               ops = 0;
+        Tablebases::ProbeState result;
+
+        for (Sample& s : samples)
+            if (s.pos.count<ALL_PIECES>() <= Tablebases::MaxCardinality
+                && !s.pos.can_castle(ANY_CASTLING))
+                Sink += Tablebases::probe_wdl(s.pos, &result) + result, ++ops;
+        return ops;
+    });
+
+    sync_cout << "\n(checksum " << Sink % 1000 << ")" << sync_endl;
+}
+
+}  // namespace Stockfish
@@ -0,0 +1,45 @@
+/*
+  Stockfish, a UCI chess playing engine derived from Glaurung 2.1
+  Copyright (C) 2004-2024 The Stockfish developers (see AUTHORS file)
+
+  Stockfish is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Stockfish is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef MICROBENCH_H_INCLUDED
+#define MICROBENCH_H_INCLUDED
+
+#include <iosfwd>
+
+namespace Stockfish {
+
+class Position;
+class TranspositionTable;
+
+namespace Eval::NNUE {
+struct Networks;
+}
+
+// Times the engine primitives (move generation, do/undo, SEE, TT probe, NNUE
+// updates and propagation, MovePicker and WDL probing) in isolation over the
+// bench positions, and prints the cost of each in ns/op. The arguments are the
+// number of repetitions, the duration of a repetition in ms and the positions
+// file, as for bench. Example: microbench 5 200 default
+void microbench(const Position&             current,
+                std::istream&               args,
+                const Eval::NNUE::Networks& networks,
+                const TranspositionTable&   tt);
+
+}  // namespace Stockfish
+
+#endif  // #ifndef MICROBENCH_H_INCLUDED
@@ -49,18 +49,25 @@ using fun8_t = bool (*)(HANDLE, BOOL, PTOKEN_PRIVILEGES, DWORD, PTOKEN_PRIVILEGE
 
 #include <atomic>
 #include <cmath>
+#include <condition_variable>
 #include <cstdlib>
+#include <deque>
 #include <fstream>
 #include <iomanip>
 #include <iostream>
 #include <mutex>
 #include <sstream>
 #include <string_view>
+#include <thread>
 
 #include "types.h"
 
 #if defined(__linux__) && !defined(__ANDROID__)
+    #include <linux/perf_event.h>
+    #include <sys/ioctl.h>
     #include <sys/mman.h>
+    #include <sys/syscall.h>
+    #include <unistd.h>
 #endif
 
 #if defined(__APPLE__) || defined(__ANDROID__) || defined(__OpenBSD__) \
@@ -82,50 +89,184 @@ constexpr std::string_view version = "dev";
 // can toggle the logging of std::cout and std:cin at runtime whilst preserving
 // usual I/O functionality, all without changing a single line of code!
 // Idea from http://groups.google.com/group/comp.lang.c++/msg/1d941c0f26ea0d81
+//
+// The file is written by a background thread, so that logging adds no latency
+// to the I/O: each Tie collects a line and hands it over, complete, through a
+// lock-free ring buffer, which the writer thread drains. When a ring is full
+// the line either waits for room or is dropped, see the "Debug Log Overflow"
+// option.
+
+// Single producer, single consumer queue of bytes
+class LogRing {
+
+    static constexpr size_t Size = 1 << 20;
+
+   public:
+    // Appends the whole of [str, str + n) or nothing if there isn't room
+    bool push(const char* str, size_t n) {
+
+        size_t h = head.load(std::memory_order_relaxed);
+
+        if (n > Size - (h - tail.load(std::memory_order_acquire)))
+            return false;
+
+        for (size_t i = 0; i < n; ++i)
+            data[(h + i) & (Size - 1)] = str[i];
+
+        head.store(h + n, std::memory_order_release);
+        return true;
+    }
+
+    // Writes the queued bytes to the stream and returns their number
+    size_t pop(std::ostream& os) {
+
+        size_t h = head.load(std::memory_order_acquire);
+        size_t t = tail.load(std::memory_order_relaxed);
+        size_t n = h - t, first = std::min(n, Size - (t & (Size - 1)));
+
+        os.write(&data[t & (Size - 1)], std::streamsize(first));
+        os.write(&data[0], std::streamsize(n - first));
+
+        tail.store(h, std::memory_order_release);
+        return n;
+    }
+
+    static constexpr size_t capacity() { return Size; }
+
+   private:
+    std::unique_ptr<char[]> data = std::make_unique<char[]>(Size);
+    alignas(64) std::atomic<size_t> head{0};
+    alignas(64) std::atomic<size_t> tail{0};
+};
 
 struct Tie: public std::streambuf {  // MSVC requires split streambuf for cin and cout
 
-    Tie(std::streambuf* b, std::streambuf* l) :
+    Tie(std::streambuf* b, const char* p) :
         buf(b),
-        logBuf(l) {}
+        prefix(p) {
+        line.reserve(4096);
+    }
 
-    int sync() override { return logBuf->pubsync(), buf->pubsync(); }
-    int overflow(int c) override { return log(buf->sputc(char(c)), "<< "); }
+    int sync() override { return buf->pubsync(); }
+    int overflow(int c) override { return log(buf->sputc(char(c))); }
     int underflow() override { return buf->sgetc(); }
-    int uflow() override { return log(buf->sbumpc(), ">> "); }
+    int uflow() override { return log(buf->sbumpc()); }
+
+    std::streambuf*      buf;
+    const char*          prefix;
+    std::string          line;
+    LogRing              ring;
+    std::atomic<bool>    dropOnOverflow{false};
+    std::atomic<int64_t> dropped{0};
+
+    int log(int c) {
+
+        if (c == EOF)
+            return c;
+
+        if (line.empty())
+            line = prefix;
 
-    std::streambuf *buf, *logBuf;
+        line += char(c);
 
-    int log(int c, const char* prefix) {
+        if (c == '\n')
+            flush_line();
 
-        static int last = '\n';  // Single log file
+        return c;
+    }
+
+    // Queues the current line, also called on a partial one when the logger stops
+    void flush_line() {
+
+        if (line.empty())
+            return;
+
+        if (line.back() != '\n')
+            line += '\n';
 
-        if (last == '\n')
-            logBuf->sputn(prefix, 3);
+        // A line that can never fit is dropped whatever the policy
+        while (!ring.push(line.data(), line.size()))
+            if (dropOnOverflow || line.size() > LogRing::capacity())
+            {
+                ++dropped;
+                break;
+            }
+            else
+                std::this_thread::yield();
 
-        return last = logBuf->sputc(char(c));
+        line.clear();
     }
 };
 
 class Logger {
 
     Logger() :
-        in(std::cin.rdbuf(), file.rdbuf()),
-        out(std::cout.rdbuf(), file.rdbuf()) {}
+        in(std::cin.rdbuf(), ">> "),
+        out(std::cout.rdbuf(), "<< ") {}
     ~Logger() { start(""); }
 
-    std::ofstream file;
-    Tie           in, out;
+    std::ofstream           file;
+    Tie                     in, out;
+    std::thread             writer;
+    std::mutex              mutex;
+    std::condition_variable cv;
+    bool                    running = false;
+
+    // Drains the rings every few milliseconds, and a last time when stopped
+    void write_loop() {
+
+        int64_t reported = 0;
+        bool    stop;
+
+        do
+        {
+            {
+                std::unique_lock<std::mutex> lk(mutex);
+                cv.wait_for(lk, std::chrono::milliseconds(5), [&] { return !running; });
+                stop = !running;
+            }
+
+            size_t  n       = in.ring.pop(file) + out.ring.pop(file);
+            int64_t dropped = in.dropped + out.dropped;
+
+            if (dropped != reported)
+            {
+                file << "-- " << dropped - reported << " lines dropped, log buffer full --\n";
+                reported = dropped;
+            }
+
+            if (n || stop)
+                file.flush();
+
+        } while (!stop);
+    }
+
+    static Logger& instance() {
+
+        static Logger l;
+        return l;
+    }
 
    public:
     static void start(const std::string& fname) {
 
-        static Logger l;
+        Logger& l = instance();
 
         if (l.file.is_open())
         {
             std::cout.rdbuf(l.out.buf);
             std::cin.rdbuf(l.in.buf);
+
+            // The writer drains the rings a last time before exiting
+            l.in.flush_line();
+            l.out.flush_line();
+
+            {
+                std::lock_guard<std::mutex> lk(l.mutex);
+                l.running = false;
+            }
+            l.cv.notify_one();
+            l.writer.join();
             l.file.close();
         }
 
@@ -139,10 +280,20 @@ class Logger {
                 exit(EXIT_FAILURE);
             }
 
+            l.in.dropped = l.out.dropped = 0;
+            l.running                    = true;
+            l.writer                     = std::thread(&Logger::write_loop, &l);
+
             std::cin.rdbuf(&l.in);
             std::cout.rdbuf(&l.out);
         }
     }
+
+    static void set_overflow(bool drop) {
+
+        Logger& l = instance();
+        l.in.dropOnOverflow = l.out.dropOnOverflow = drop;
+    }
 };
 
 }  // namespace
@@ -309,7 +460,10 @@ std::string compiler_info() {
 }
 
 
-// Debug functions used mainly to collect run-time statistics
+// Debug functions used mainly to collect run-time statistics. Every thread
+// updates its own shard of the counters, on its own cache lines, so that hot
+// paths can be instrumented with many threads without contention. The shards
+// are only summed up by dbg_print().
 constexpr int MaxDebugSlots = 32;
 
 namespace {
@@ -318,77 +472,140 @@ template<size_t N>
 struct DebugInfo {
     std::atomic<int64_t> data[N] = {0};
 
-    constexpr inline std::atomic<int64_t>& operator[](int index) { return data[index]; }
+    // Only the owning thread writes, so a relaxed load and store is enough
+    void add(int index, int64_t value) {
+        data[index].store(data[index].load(std::memory_order_relaxed) + value,
+                          std::memory_order_relaxed);
+    }
+
+    int64_t operator[](int index) const { return data[index].load(std::memory_order_relaxed); }
+};
+
+struct alignas(64) DebugShard {
+    DebugInfo<2> hit[MaxDebugSlots];
+    DebugInfo<2> mean[MaxDebugSlots];
+    DebugInfo<3> stdev[MaxDebugSlots];
+    DebugInfo<6> correl[MaxDebugSlots];
 };
 
-DebugInfo<2> hit[MaxDebugSlots];
-DebugInfo<2> mean[MaxDebugSlots];
-DebugInfo<3> stdev[MaxDebugSlots];
-DebugInfo<6> correl[MaxDebugSlots];
+// Shards are never freed, so that the counts of exited threads are kept
+std::mutex             debugMutex;
+std::deque<DebugShard> debugShards;
+std::string            debugLabels[MaxDebugSlots];
+
+DebugShard& local_shard() {
+
+    thread_local DebugShard* shard = nullptr;
+
+    if (!shard)
+    {
+        std::lock_guard<std::mutex> lock(debugMutex);
+        shard = &debugShards.emplace_back();
+    }
+
+    return *shard;
+}
+
+// Sums the given counters of a slot over all the shards
+template<size_t N>
+std::array<int64_t, N> total(DebugInfo<N> (DebugShard::*info)[MaxDebugSlots], int slot) {
+
+    std::array<int64_t, N> sum = {};
+
+    for (const DebugShard& shard : debugShards)
+        for (size_t i = 0; i < N; ++i)
+            sum[i] += (shard.*info)[slot][i];
+
+    return sum;
+}
+
+std::string slot_name(int slot) {
+    return debugLabels[slot].empty() ? "#" + std::to_string(slot)
+                                     : "#" + std::to_string(slot) + " (" + debugLabels[slot] + ")";
+}
 
 }  // namespace
 
+void dbg_label(int slot, const std::string& label) {
+
+    std::lock_guard<std::mutex> lock(debugMutex);
+    debugLabels[slot] = label;
+}
+
 void dbg_hit_on(bool cond, int slot) {
 
-    ++hit[slot][0];
+    DebugInfo<2>& hit = local_shard().hit[slot];
+
+    hit.add(0, 1);
     if (cond)
-        ++hit[slot][1];
+        hit.add(1, 1);
 }
 
 void dbg_mean_of(int64_t value, int slot) {
 
-    ++mean[slot][0];
-    mean[slot][1] += value;
+    DebugInfo<2>& mean = local_shard().mean[slot];
+
+    mean.add(0, 1);
+    mean.add(1, value);
 }
 
 void dbg_stdev_of(int64_t value, int slot) {
 
-    ++stdev[slot][0];
-    stdev[slot][1] += value;
-    stdev[slot][2] += value * value;
+    DebugInfo<3>& stdev = local_shard().stdev[slot];
+
+    stdev.add(0, 1);
+    stdev.add(1, value);
+    stdev.add(2, value * value);
 }
 
 void dbg_correl_of(int64_t value1, int64_t value2, int slot) {
 
-    ++correl[slot][0];
-    correl[slot][1] += value1;
-    correl[slot][2] += value1 * value1;
-    correl[slot][3] += value2;
-    correl[slot][4] += value2 * value2;
-    correl[slot][5] += value1 * value2;
+    DebugInfo<6>& correl = local_shard().correl[slot];
+
+    correl.add(0, 1);
+    correl.add(1, value1);
+    correl.add(2, value1 * value1);
+    correl.add(3, value2);
+    correl.add(4, value2 * value2);
+    correl.add(5, value1 * value2);
 }
 
 void dbg_print() {
 
+    std::lock_guard<std::mutex> lock(debugMutex);
+
     int64_t n;
     auto    E   = [&n](int64_t x) { return double(x) / n; };
     auto    sqr = [](double x) { return x * x; };
 
     for (int i = 0; i < MaxDebugSlots; ++i)
-        if ((n = hit[i][0]))
-            std::cerr << "Hit #" << i << ": Total " << n << " Hits " << hit[i][1]
-                      << " Hit Rate (%) " << 100.0 * E(hit[i][1]) << std::endl;
+        if (auto hit = total(&DebugShard::hit, i); (n = hit[0]))
+            std::cerr << "Hit " << slot_name(i) << ": Total " << n << " Hits " << hit[1]
+                      << " Hit Rate (%) " << 100.0 * E(hit[1]) << std::endl;
 
     for (int i = 0; i < MaxDebugSlots; ++i)
-        if ((n = mean[i][0]))
+        if (auto mean = total(&DebugShard::mean, i); (n = mean[0]))
         {
-            std::cerr << "Mean #" << i << ": Total " << n << " Mean " << E(mean[i][1]) << std::endl;
+            std::cerr << "Mean " << slot_name(i) << ": Total " << n << " Mean " << E(mean[1])
+                      << std::endl;
         }
 
     for (int i = 0; i < MaxDebugSlots; ++i)
-        if ((n = stdev[i][0]))
+        if (auto stdev = total(&DebugShard::stdev, i); (n = stdev[0]))
         {
-            double r = sqrt(E(stdev[i][2]) - sqr(E(stdev[i][1])));
-            std::cerr << "Stdev #" << i << ": Total " << n << " Stdev " << r << std::endl;
+            double r = sqrt(E(stdev[2]) - sqr(E(stdev[1])));
+            std::cerr << "Stdev " << slot_name(i) << ": Total " << n << " Mean " << E(stdev[1])
+                      << " Stdev " << r << std::endl;
         }
 
     for (int i = 0; i < MaxDebugSlots; ++i)
-        if ((n = correl[i][0]))
+        if (auto correl = total(&DebugShard::correl, i); (n = correl[0]))
         {
-            double r = (E(correl[i][5]) - E(correl[i][1]) * E(correl[i][3]))
-                     / (sqrt(E(correl[i][2]) - sqr(E(correl[i][1])))
-                        * sqrt(E(correl[i][4]) - sqr(E(correl[i][3]))));
-            std::cerr << "Correl. #" << i << ": Total " << n << " Coefficient " << r << std::endl;
+            double r = (E(correl[5]) - E(correl[1]) * E(correl[3]))
+                     / (sqrt(E(correl[2]) - sqr(E(correl[1])))
+                        * sqrt(E(correl[4]) - sqr(E(correl[3]))));
+            std::cerr << "Correl. " << slot_name(i) << ": Total " << n << " Coefficient " << r
+                      << std::endl;
         }
 }
 
@@ -411,6 +628,7 @@ std::ostream& operator<<(std::ostream& os, SyncCout sc) {
 
 // Trampoline helper to avoid moving Logger to misc.h
 void start_logger(const std::string& fname) { Logger::start(fname); }
+void set_logger_overflow(bool drop) { Logger::set_overflow(drop); }
 
 
 #ifdef NO_PREFETCH
@@ -592,6 +810,98 @@ void aligned_large_pages_free(void* mem) { std_aligned_free(mem); }
 #endif
 
 
+#if defined(__linux__) && !defined(__ANDROID__)
+
+namespace {
+
+// Opens one event counting the user space activity of the calling thread, disabled
+int perf_event_open(uint32_t type, uint64_t config) {
+
+    perf_event_attr attr{};
+    attr.size           = sizeof(attr);
+    attr.type           = type;
+    attr.config         = config;
+    attr.disabled       = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv     = 1;
+    attr.read_format    = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+    return int(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+}
+
+constexpr uint64_t read_miss(uint64_t cache) {
+    return cache | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+}
+
+}
+
+PerfCounters::~PerfCounters() {
+    for (int f : fd)
+        if (f >= 0)
+            close(f);
+}
+
+void PerfCounters::start() {
+
+    if (!enabled)
+        return;
+
+    if (!opened)
+    {
+        opened = true;
+
+        fd[Cycles]       = perf_event_open(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+        fd[Instructions] = perf_event_open(PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+        fd[L1DMisses]    = perf_event_open(PERF_TYPE_HW_CACHE, read_miss(PERF_COUNT_HW_CACHE_L1D));
+        fd[LLCMisses]    = perf_event_open(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+        fd[BranchMisses] = perf_event_open(PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES);
+        fd[DTLBMisses]   = perf_event_open(PERF_TYPE_HW_CACHE, read_miss(PERF_COUNT_HW_CACHE_DTLB));
+    }
+
+    for (int f : fd)
+        if (f >= 0)
+        {
+            ioctl(f, PERF_EVENT_IOC_RESET, 0);
+            ioctl(f, PERF_EVENT_IOC_ENABLE, 0);
+        }
+
+    running = true;
+}
+
+void PerfCounters::stop() {
+
+    if (!running)
+        return;
+
+    running = false;
+
+    for (int e = 0; e < EVENT_NB; ++e)
+        if (fd[e] >= 0)
+        {
+            uint64_t data[3];  // Value, time enabled, time running
+
+            ioctl(fd[e], PERF_EVENT_IOC_DISABLE, 0);
+
+            // Scale up the value if the event was multiplexed with others
+            if (read(fd[e], data, sizeof(data)) == sizeof(data) && data[2])
+                counts[e] += uint64_t(double(data[0]) * data[1] / data[2]);
+        }
+}
+
+#else
+
+PerfCounters::~PerfCounters() {}
+void PerfCounters::start() {}
+void PerfCounters::stop() {}
+
+#endif
+
+const char* PerfCounters::name(Event e) {
+    constexpr const char* Names[] = {"Cycles",     "Instructions",  "L1D misses",
+                                     "LLC misses", "Branch misses", "dTLB misses"};
+    return Names[e];
+}
+
 namespace WinProcGroup {
 
 #ifndef _WIN32
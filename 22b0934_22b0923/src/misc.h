@@ -20,6 +20,7 @@
 #define MISC_H_INCLUDED
 
 #include <algorithm>
+#include <array>
 #include <cassert>
 #include <chrono>
 #include <cstddef>
@@ -43,6 +44,7 @@ std::string compiler_info();
 void prefetch(void* addr);
 
 void  start_logger(const std::string& fname);
+void  set_logger_overflow(bool drop);  // Drop lines instead of waiting when the log is behind
 void* std_aligned_alloc(size_t alignment, size_t size);
 void  std_aligned_free(void* ptr);
 // memory aligned by page size, min alignment: 4096 bytes
@@ -74,12 +76,83 @@ template<typename T>
 using LargePagePtr = std::unique_ptr<T, LargePageDeleter<T>>;
 
 
+void dbg_label(int slot, const std::string& label);
 void dbg_hit_on(bool cond, int slot = 0);
 void dbg_mean_of(int64_t value, int slot = 0);
 void dbg_stdev_of(int64_t value, int slot = 0);
 void dbg_correl_of(int64_t value1, int64_t value2, int slot = 0);
 void dbg_print();
 
+// Times its scope in nanoseconds and adds it to dbg_stdev_of(slot), but only
+// for one in 2^SampleShift instances on each thread, so that it can be left
+// in hot paths: the other instances cost just a thread local increment.
+// Example: { DbgSampledTimer t(3); ... }
+template<int SampleShift = 6>
+class DbgSampledTimer {
+   public:
+    explicit DbgSampledTimer(int s) :
+        slot(s),
+        sampled(!(counter()++ & ((1 << SampleShift) - 1))) {
+        if (sampled)
+            start = std::chrono::steady_clock::now();
+    }
+
+    ~DbgSampledTimer() {
+        if (sampled)
+            dbg_stdev_of(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                           std::chrono::steady_clock::now() - start)
+                           .count(),
+                         slot);
+    }
+
+   private:
+    static uint64_t& counter() {
+        thread_local uint64_t n = 0;
+        return n;
+    }
+
+    int                                   slot;
+    bool                                  sampled;
+    std::chrono::steady_clock::time_point start;
+};
+
+// Hardware performance counters of the calling thread, read with perf_event_open()
+// on Linux. The events are opened by the first start(), from the thread to be
+// measured, and each start()/stop() pair adds to 'counts'. Events that can't be
+// opened (other systems, no kernel support, perf_event_paranoid too restrictive)
+// are simply not counted and available() returns false for them.
+class PerfCounters {
+   public:
+    enum Event {
+        Cycles,
+        Instructions,
+        L1DMisses,
+        LLCMisses,
+        BranchMisses,
+        DTLBMisses,
+        EVENT_NB
+    };
+
+    PerfCounters()                    = default;
+    PerfCounters(const PerfCounters&) = delete;
+    ~PerfCounters();
+
+    void start();
+    void stop();
+    void clear() { counts = {}; }
+    bool available(Event e) const { return fd[e] >= 0; }
+
+    static const char* name(Event e);
+
+    bool                           enabled = false;
+    std::array<uint64_t, EVENT_NB> counts  = {};
+
+   private:
+    bool opened       = false;
+    bool running      = false;
+    int  fd[EVENT_NB] = {-1, -1, -1, -1, -1, -1};
+};
+
 using TimePoint = std::chrono::milliseconds::rep;  // A value in milliseconds
 static_assert(sizeof(TimePoint) == sizeof(int64_t), "TimePoint should be 64 bits");
 inline TimePoint now() {
@@ -154,6 +154,59 @@ void Network<Arch, Transformer>::load(const std::string& rootDirectory, std::str
 }
 
 
+template<typename Arch, typename Transformer>
+void Network<Arch, Transformer>::load_async(const std::string& rootDirectory,
+                                            std::string        evalfilePath) {
+    if (evalfilePath.empty())
+        evalfilePath = evalFile.defaultName;
+
+    pending.reset();  // Wait for, and drop, a load still in progress
+
+    if (evalFile.current == evalfilePath)
+        return;
+
+    pending       = std::make_unique<PendingLoad>();
+    pending->path = evalfilePath;
+    pending->net =
+      std::make_unique<Network>(EvalFile{evalFile.defaultName, "None", ""}, embeddedType);
+
+    pending->thread = std::thread([p = pending.get(), rootDirectory, evalfilePath]() {
+        p->net->load(rootDirectory, evalfilePath);
+        p->done = true;
+    });
+}
+
+
+// Installs the net loaded by load_async() if it is ready, in place of the
+// current one, whose buffers are freed. It must be called while no evaluation
+// is running. Returns whether the net changed. A net that failed to load is
+// dropped and the current one is kept. Without a usable current net, e.g. when
+// the default one is missing, this waits for the load to finish instead.
+template<typename Arch, typename Transformer>
+bool Network<Arch, Transformer>::swap_pending() {
+    if (!pending || (!pending->done && evalFile.current != "None"))
+        return false;
+
+    pending->thread.join();
+
+    Network& next   = *pending->net;
+    bool     loaded = next.evalFile.current == pending->path;
+
+    if (loaded)
+    {
+        std::swap(featureTransformer, next.featureTransformer);
+
+        for (std::size_t i = 0; i < LayerStacks; ++i)
+            std::swap(network[i], next.network[i]);
+
+        evalFile = next.evalFile;
+    }
+
+    pending.reset();
+    return loaded;
+}
+
+
 template<typename Arch, typename Transformer>
 bool Network<Arch, Transformer>::save(const std::optional<std::string>& filename) const {
     std::string actualFilename;
@@ -226,10 +279,19 @@ Value Network<Arch, Transformer>::evaluate(const Position& pos,
 
 
 template<typename Arch, typename Transformer>
-void Network<Arch, Transformer>::verify(std::string evalfilePath) const {
+void Network<Arch, Transformer>::verify(std::string evalfilePath, bool silent) const {
     if (evalfilePath.empty())
         evalfilePath = evalFile.defaultName;
 
+    // A valid current net keeps serving until the requested one is installed
+    if (pending && pending->path == evalfilePath && evalFile.current != "None")
+    {
+        if (!silent)
+            sync_cout << "info string NNUE evaluation using " << evalFile.current << ", "
+                      << evalfilePath << " is loading" << sync_endl;
+        return;
+    }
+
     if (evalFile.current != evalfilePath)
     {
         std::string msg1 =
@@ -250,7 +312,8 @@ void Network<Arch, Transformer>::verify(std::string evalfilePath) const {
         exit(EXIT_FAILURE);
     }
 
-    sync_cout << "info string NNUE evaluation using " << evalfilePath << sync_endl;
+    if (!silent)
+        sync_cout << "info string NNUE evaluation using " << evalfilePath << sync_endl;
 }
 
 
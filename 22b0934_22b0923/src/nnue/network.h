@@ -19,10 +19,13 @@
 #ifndef NETWORK_H_INCLUDED
 #define NETWORK_H_INCLUDED
 
+#include <atomic>
 #include <cstdint>
 #include <iostream>
+#include <memory>
 #include <optional>
 #include <string>
+#include <thread>
 #include <utility>
 
 #include "../misc.h"
@@ -51,6 +54,11 @@ class Network {
     void load(const std::string& rootDirectory, std::string evalfilePath);
     bool save(const std::optional<std::string>& filename) const;
 
+    // Loads a net on a background thread into buffers of its own, while the
+    // current net stays in use. swap_pending() installs it once it is ready.
+    void load_async(const std::string& rootDirectory, std::string evalfilePath);
+    bool swap_pending();
+
 
     Value evaluate(const Position& pos,
                    bool            adjusted   = false,
@@ -60,7 +68,7 @@ class Network {
 
     void hint_common_access(const Position& pos, bool psqtOnl) const;
 
-    void          verify(std::string evalfilePath) const;
+    void          verify(std::string evalfilePath, bool silent = false) const;
     NnueEvalTrace trace_evaluate(const Position& pos) const;
 
    private:
@@ -78,6 +86,19 @@ class Network {
     bool read_parameters(std::istream&, std::string&) const;
     bool write_parameters(std::ostream&, const std::string&) const;
 
+    // A net being loaded by load_async()
+    struct PendingLoad {
+        ~PendingLoad() {
+            if (thread.joinable())
+                thread.join();
+        }
+
+        std::unique_ptr<Network> net;
+        std::string              path;
+        std::atomic_bool         done = false;
+        std::thread              thread;
+    };
+
     // Input feature converter
     LargePagePtr<Transformer> featureTransformer;
 
@@ -87,6 +108,8 @@ class Network {
     EvalFile         evalFile;
     EmbeddedNNUEType embeddedType;
 
+    std::unique_ptr<PendingLoad> pending;
+
     // Hash value of evaluation function structure
     static constexpr std::uint32_t hash = Transformer::get_hash_value() ^ Arch::get_hash_value();
 };
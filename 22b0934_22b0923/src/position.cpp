@@ -368,6 +368,26 @@ void Position::set_state() const {
 }
 
 
+// Overload to initialize the position object as a copy of another one, without
+// going through a FEN string. The current state is copied into 'si', whose
+// 'previous' still points to the (read-only) earlier states of 'pos'. Passing
+// the state of 'pos' itself shares it instead, which is safe as long as nobody
+// writes to it, e.g. once its accumulators are computed.
+Position& Position::set(const Position& pos, StateInfo* si) {
+
+    std::memcpy(static_cast<void*>(this), &pos, sizeof(Position));
+
+    if (si != pos.st)
+        *si = *pos.st;
+
+    st = si;
+
+    assert(pos_is_ok());
+
+    return *this;
+}
+
+
 // Overload to initialize the position object with the given endgame code string
 // like "KBPKN". It's mainly a helper to get the material key out of an endgame code.
 Position& Position::set(const string& code, Color c, StateInfo* si) {
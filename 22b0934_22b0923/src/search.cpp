@@ -22,12 +22,15 @@
 #include <array>
 #include <atomic>
 #include <cassert>
+#include <chrono>
 #include <cmath>
 #include <cstdint>
 #include <cstdlib>
 #include <initializer_list>
+#include <iomanip>
 #include <iostream>
 #include <sstream>
+#include <thread>
 #include <utility>
 
 #include "evaluate.h"
@@ -148,23 +151,33 @@ void Search::Worker::start_searching() {
     if (!is_mainthread())
     {
         iterative_deepening();
+        publish_counters();
         return;
     }
 
     main_manager()->tm.init(limits, rootPos.side_to_move(), rootPos.game_ply(), options);
-    tt.new_search();
+
+    if (!threads.sharedHash)
+        tt.new_search();
+
+    main_manager()->lastPvTime  = 0;
+    main_manager()->lastInfoKey = 0;
+    main_manager()->infoPending = false;
 
     if (rootMoves.empty())
     {
         rootMoves.emplace_back(Move::none());
-        sync_cout << "info depth 0 score "
-                  << UCI::to_score(rootPos.checkers() ? -VALUE_MATE : VALUE_DRAW, rootPos)
-                  << sync_endl;
+
+        if (!main_manager()->silent)
+            sync_cout << "info depth 0 score "
+                      << UCI::to_score(rootPos.checkers() ? -VALUE_MATE : VALUE_DRAW, rootPos)
+                      << sync_endl;
     }
     else
     {
         threads.start_searching();  // start non-main threads
         iterative_deepening();      // main thread start searching
+        publish_counters();
     }
 
     // When we reach the maximum depth, we can arrive here without a raise of
@@ -199,8 +212,29 @@ void Search::Worker::start_searching() {
     main_manager()->bestPreviousScore        = bestThread->rootMoves[0].score;
     main_manager()->bestPreviousAverageScore = bestThread->rootMoves[0].averageScore;
 
-    // Send again PV info if we have a new best thread
-    if (bestThread != this)
+    // Record the outcome, with the score reported the same way as in pv()
+    const RootMove& best   = bestThread->rootMoves[0];
+    SearchResult&   result = main_manager()->result;
+    Value           v = best.score != -VALUE_INFINITE ? best.uciScore : best.previousScore;
+
+    if (best.pv[0] == Move::none())
+        v = rootPos.checkers() ? -VALUE_MATE : VALUE_DRAW;
+    else if (v == -VALUE_INFINITE)
+        v = VALUE_ZERO;
+
+    result.pv       = best.pv;
+    result.score    = tbConfig.rootInTB && std::abs(v) <= VALUE_TB ? best.tbScore : v;
+    result.depth    = bestThread->completedDepth;
+    result.selDepth = best.selDepth;
+    result.nodes    = threads.nodes_searched();
+    result.time     = main_manager()->tm.elapsed(result.nodes);
+
+    if (main_manager()->silent)
+        return;
+
+    // Send again PV info if we have a new best thread, or if the last update
+    // was held back by the info rate limit.
+    if (bestThread != this || main_manager()->infoPending)
         sync_cout << main_manager()->pv(*bestThread, threads, tt, bestThread->completedDepth)
                   << sync_endl;
 
@@ -258,6 +292,17 @@ void Search::Worker::iterative_deepening() {
             mainThread->iterValue.fill(mainThread->bestPreviousScore);
     }
 
+    // A resumed search starts from the result of the previous one, see
+    // ThreadPool::start_thinking(), which is reported again right away.
+    if (completedDepth > 0)
+    {
+        lastBestPV    = rootMoves[0].pv;
+        lastBestScore = rootMoves[0].score;
+
+        if (mainThread && !mainThread->silent)
+            sync_cout << main_manager()->pv(*this, threads, tt, completedDepth) << sync_endl;
+    }
+
     size_t multiPV = size_t(options["MultiPV"]);
     Skill skill(options["Skill Level"], options["UCI_LimitStrength"] ? int(options["UCI_Elo"]) : 0);
 
@@ -268,20 +313,35 @@ void Search::Worker::iterative_deepening() {
 
     multiPV = std::min(multiPV, rootMoves.size());
 
+    // With MultiPVSplit the threads are split in groups, one per PV line up to
+    // the number of threads, and each group searches only the lines i with
+    // i % pvGroups == pvGroup. The groups share their lines at iteration ends.
+    size_t pvGroups = options["MultiPVSplit"] ? std::min(multiPV, threads.size()) : 1;
+    size_t pvGroup  = thread_idx % pvGroups;
+
     int searchAgainCounter = 0;
 
     // Iterative deepening loop until requested to stop or the target depth is reached
+    // With MultiPVSplit every group stops at the depth limit, not only the
+    // main thread, so that no line is published deeper than requested.
     while (++rootDepth < MAX_PLY && !threads.stop
-           && !(limits.depth && mainThread && rootDepth > limits.depth))
+           && !(limits.depth && (mainThread || pvGroups > 1) && rootDepth > limits.depth))
     {
         // Age out PV variability metric
         if (mainThread)
             totBestMoveChanges /= 2;
 
+        // A group starts an iteration only once all the lines have been searched
+        // to the previous depth, so the published lines are never more than one
+        // iteration apart, as with the usual MultiPV after an interrupted iteration.
+        if (pvGroups > 1)
+            wait_for_lines(multiPV, rootDepth - 1);
+
         // Save the last iteration's scores before the first PV line is searched and
         // all the move scores except the (new) PV are set to -VALUE_INFINITE.
+        // Line depths are kept only by merge_lines(), unused ones would be stale
         for (RootMove& rm : rootMoves)
-            rm.previousScore = rm.score;
+            rm.previousScore = rm.score, rm.depth = pvGroups > 1 ? rm.depth : 0;
 
         size_t pvFirst = 0;
         pvLast         = 0;
@@ -289,6 +349,8 @@ void Search::Worker::iterative_deepening() {
         if (!threads.increaseDepth)
             searchAgainCounter++;
 
+        uint64_t iterationStartNodes = nodes;
+
         // MultiPV loop. We perform a full root search for each PV line
         for (pvIdx = 0; pvIdx < multiPV && !threads.stop; ++pvIdx)
         {
@@ -300,6 +362,9 @@ void Search::Worker::iterative_deepening() {
                         break;
             }
 
+            if (pvIdx % pvGroups != pvGroup)
+                continue;
+
             // Reset UCI info selDepth for each depth and each PV line
             selDepth = 0;
 
@@ -325,6 +390,10 @@ void Search::Worker::iterative_deepening() {
                   std::max(1, rootDepth - failedHighCnt - 3 * (searchAgainCounter + 1) / 4);
                 bestValue = search<Root>(rootPos, ss, alpha, beta, adjustedDepth, false);
 
+                // Make the node count exact for the info lines and the time
+                // management below, which read the published totals.
+                publish_counters();
+
                 // Bring the best move to the front. It is critical that sorting
                 // is done with a stable algorithm because all the values but the
                 // first and eventually the new best one is set to -VALUE_INFINITE
@@ -341,8 +410,10 @@ void Search::Worker::iterative_deepening() {
 
                 // When failing high/low give some update (without cluttering
                 // the UI) before a re-search.
-                if (mainThread && multiPV == 1 && (bestValue <= alpha || bestValue >= beta)
-                    && mainThread->tm.elapsed(threads.nodes_searched()) > 3000)
+                if (mainThread && !mainThread->silent && multiPV == 1
+                    && (bestValue <= alpha || bestValue >= beta)
+                    && mainThread->tm.elapsed(threads.nodes_searched()) > 3000
+                    && mainThread->info_due(*this, rootDepth))
                     sync_cout << main_manager()->pv(*this, threads, tt, rootDepth) << sync_endl;
 
                 // In case of failing low/high increase aspiration window and
@@ -364,27 +435,59 @@ void Search::Worker::iterative_deepening() {
                 else
                     break;
 
+                stats.hit(SearchStats::AspirationResearch);
                 delta += delta / 3;
 
                 assert(alpha >= -VALUE_INFINITE && beta <= VALUE_INFINITE);
             }
 
+            if (pvGroups > 1)
+            {
+                if (!threads.stop)
+                    publish_line(pvIdx);
+                continue;
+            }
+
             // Sort the PV lines searched so far and update the GUI
             std::stable_sort(rootMoves.begin() + pvFirst, rootMoves.begin() + pvIdx + 1);
 
-            if (mainThread
+            if (mainThread && !mainThread->silent
                 && (threads.stop || pvIdx + 1 == multiPV
                     || mainThread->tm.elapsed(threads.nodes_searched()) > 3000)
                 // A thread that aborted search can have mated-in/TB-loss PV and score
                 // that cannot be trusted, i.e. it can be delayed or refuted if we would have
                 // had time to fully search other root-moves. Thus we suppress this output and
                 // below pick a proven score/PV for this thread (from the previous iteration).
-                && !(threads.abortedSearch && rootMoves[0].uciScore <= VALUE_TB_LOSS_IN_MAX_PLY))
+                && !(threads.abortedSearch && rootMoves[0].uciScore <= VALUE_TB_LOSS_IN_MAX_PLY)
+                && mainThread->info_due(*this, rootDepth))
+                sync_cout << main_manager()->pv(*this, threads, tt, rootDepth) << sync_endl;
+        }
+
+        if (pvGroups > 1)
+        {
+            // The last iteration of a depth limited search ends with all the
+            // lines searched to that depth.
+            bool lastIteration = mainThread && limits.depth && rootDepth >= limits.depth;
+
+            if (lastIteration)
+                wait_for_lines(multiPV, limits.depth);
+
+            merge_lines(multiPV);
+
+            if (lastIteration)
+                search_missing_lines(ss, multiPV);
+
+            if (mainThread && !mainThread->silent
+                && !(threads.abortedSearch && rootMoves[0].uciScore <= VALUE_TB_LOSS_IN_MAX_PLY)
+                && mainThread->info_due(*this, rootDepth))
                 sync_cout << main_manager()->pv(*this, threads, tt, rootDepth) << sync_endl;
         }
 
         if (!threads.stop)
+        {
             completedDepth = rootDepth;
+            stats.iteration(rootDepth, nodes - iterationStartNodes);
+        }
 
         // We make sure not to pick an unproven mated-in score,
         // in case this thread prematurely stopped search (aborted-search).
@@ -487,6 +590,153 @@ void Search::Worker::iterative_deepening() {
                              skill.best ? skill.best : skill.pick_best(rootMoves, multiPV)));
 }
 
+// Publishes the PV line idx just searched by this thread, unless a thread of
+// the same group has already published a deeper one.
+void Search::Worker::publish_line(size_t idx) {
+
+    MultiPVLines&               shared = threads.multiPVLines;
+    std::lock_guard<std::mutex> lk(shared.mutex);
+
+    while (shared.lines.size() <= idx)
+    {
+        shared.lines.emplace_back(Move::none());
+        shared.depths.push_back(0);
+    }
+
+    if (shared.depths[idx] <= rootDepth)
+    {
+        shared.lines[idx]       = rootMoves[idx];
+        shared.lines[idx].depth = shared.depths[idx] = rootDepth;
+    }
+}
+
+// Returns the depth of the shallowest of the first multiPV lines published,
+// or 0 if some of them are still missing.
+Depth Search::Worker::min_line_depth(size_t multiPV) {
+
+    MultiPVLines&               shared = threads.multiPVLines;
+    std::lock_guard<std::mutex> lk(shared.mutex);
+
+    if (shared.depths.size() < multiPV)
+        return 0;
+
+    return *std::min_element(shared.depths.begin(), shared.depths.begin() + multiPV);
+}
+
+// Waits until the first multiPV lines have all been published at depth d or
+// deeper, or the search stops. The main thread keeps checking the time limits.
+void Search::Worker::wait_for_lines(size_t multiPV, Depth d) {
+
+    while (!threads.stop && min_line_depth(multiPV) < d)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+        if (is_mainthread())
+        {
+            main_manager()->callsCnt = 0;
+            main_manager()->check_time(*this);
+        }
+    }
+}
+
+// Two groups can end their lines with the same move, and merge_lines() then
+// fills the free line with a move not searched at this depth. At the end of a
+// depth limited search the main thread searches such lines itself, with a full
+// window, so that all the final lines have the requested depth.
+void Search::Worker::search_missing_lines(Stack* ss, size_t multiPV) {
+
+    bool searched = false;
+
+    for (pvIdx = 0; pvIdx < multiPV && !threads.stop; ++pvIdx)
+    {
+        if (rootMoves[pvIdx].depth)
+            continue;
+
+        for (pvLast = pvIdx + 1; pvLast < rootMoves.size(); ++pvLast)
+            if (rootMoves[pvLast].tbRank != rootMoves[pvIdx].tbRank)
+                break;
+
+        selDepth = 0;
+        search<Root>(rootPos, ss, -VALUE_INFINITE, VALUE_INFINITE, rootDepth, false);
+        publish_counters();
+
+        std::stable_sort(rootMoves.begin() + pvIdx, rootMoves.begin() + pvLast);
+
+        if (!threads.stop)
+            rootMoves[pvIdx].depth = rootDepth;
+
+        searched = true;
+    }
+
+    if (searched)
+        std::stable_sort(rootMoves.begin(), rootMoves.begin() + multiPV,
+                         [](const RootMove& a, const RootMove& b) {
+                             return a.tbRank != b.tbRank ? a.tbRank > b.tbRank : a < b;
+                         });
+}
+
+// Takes the PV lines published by all the groups as the first root moves, in
+// score order, followed by the other root moves in their current order. When
+// two lines end with the same move, as can happen since the groups don't see
+// each other's current iteration, the deeper one is kept. Each merged line
+// keeps the depth it was searched to, which pv() prints.
+void Search::Worker::merge_lines(size_t multiPV) {
+
+    MultiPVLines& shared = threads.multiPVLines;
+    RootMoves     merged;
+
+    {
+        std::lock_guard<std::mutex> lk(shared.mutex);
+
+        std::vector<size_t> order;
+
+        for (size_t i = 0; i < std::min(multiPV, shared.lines.size()); ++i)
+            if (shared.depths[i])
+                order.push_back(i);
+
+        std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+            return shared.depths[a] > shared.depths[b];
+        });
+
+        for (size_t i : order)
+            if (std::find(merged.begin(), merged.end(), shared.lines[i].pv[0]) == merged.end())
+                merged.push_back(shared.lines[i]);
+    }
+
+    if (merged.empty())
+        return;
+
+    std::stable_sort(merged.begin(), merged.end());
+
+    for (RootMove& rm : rootMoves)
+        if (std::find(merged.begin(), merged.end(), rm.pv[0]) == merged.end())
+        {
+            merged.push_back(rm);
+            merged.back().depth = 0;
+        }
+
+    assert(merged.size() == rootMoves.size());
+
+    // Keep the tablebase ranking order, see rank_root_moves()
+    std::stable_sort(merged.begin(), merged.end(), [](const RootMove& a, const RootMove& b) {
+        return a.tbRank > b.tbRank;
+    });
+
+    rootMoves = std::move(merged);
+}
+
+void Search::Worker::publish_counters() {
+
+    threads.nodes.fetch_add(nodes - publishedNodes, std::memory_order_relaxed);
+    publishedNodes = nodes;
+
+    if (tbHits != publishedTbHits)
+    {
+        threads.tbHits.fetch_add(tbHits - publishedTbHits, std::memory_order_relaxed);
+        publishedTbHits = tbHits;
+    }
+}
+
 void Search::Worker::clear() {
     counterMoves.fill(Move::none());
     mainHistory.fill(0);
@@ -553,6 +803,7 @@ Value Search::Worker::search(
     moveCount = captureCount = quietCount = ss->moveCount = 0;
     bestValue                                             = -VALUE_INFINITE;
     maxValue                                              = VALUE_INFINITE;
+    thisThread->stats.node(ss->ply, depth);
 
     // Check for the available remaining time
     if (is_mainthread())
@@ -603,6 +854,7 @@ Value Search::Worker::search(
               : ss->ttHit ? tte->move()
                           : Move::none();
     ttCapture = ttMove && pos.capture_stage(ttMove);
+    thisThread->stats.hit(SearchStats::TTProbe);
 
     // At this point, if excluded, skip straight to step 6, static eval. However,
     // to save indentation, we list the condition in all code between here and there.
@@ -631,9 +883,12 @@ Value Search::Worker::search(
         // Partial workaround for the graph history interaction problem
         // For high rule50 counts don't produce transposition table cutoffs.
         if (pos.rule50_count() < 90)
+        {
+            thisThread->stats.hit(SearchStats::TTCutoff);
             return ttValue >= beta && std::abs(ttValue) < VALUE_TB_WIN_IN_MAX_PLY
                    ? (ttValue * 3 + beta) / 4
                    : ttValue;
+        }
     }
 
     // Step 5. Tablebases probe
@@ -646,7 +901,7 @@ Value Search::Worker::search(
             && pos.rule50_count() == 0 && !pos.can_castle(ANY_CASTLING))
         {
             TB::ProbeState err;
-            TB::WDLScore   wdl = Tablebases::probe_wdl(pos, &err);
+            TB::WDLScore   wdl = Tablebases::probe_wdl(pos, &err, tbConfig.nonBlocking);
 
             // Force check of time on the next occasion
             if (is_mainthread())
@@ -654,7 +909,7 @@ Value Search::Worker::search(
 
             if (err != TB::ProbeState::FAIL)
             {
-                thisThread->tbHits.fetch_add(1, std::memory_order_relaxed);
+                ++thisThread->tbHits;
 
                 int drawScore = tbConfig.useRule50 ? 1 : 0;
 
@@ -770,7 +1025,10 @@ Value Search::Worker::search(
                - (ss - 1)->statScore / 267
              >= beta
         && eval >= beta && eval < VALUE_TB_WIN_IN_MAX_PLY && (!ttMove || ttCapture))
+    {
+        thisThread->stats.hit(SearchStats::FutilityNode);
         return beta > VALUE_TB_LOSS_IN_MAX_PLY ? (eval + beta) / 2 : eval;
+    }
 
     // Step 9. Null move search with verification search (~35 Elo)
     if (!PvNode && (ss - 1)->currentMove != Move::null() && (ss - 1)->statScore < 16878
@@ -787,6 +1045,7 @@ Value Search::Worker::search(
         ss->continuationHistory = &thisThread->continuationHistory[0][0][NO_PIECE][0];
 
         pos.do_null_move(st, tt);
+        thisThread->stats.hit(SearchStats::NullMove);
 
         Value nullValue = -search<NonPV>(pos, ss + 1, -beta, -beta + 1, depth - R, !cutNode);
 
@@ -795,6 +1054,8 @@ Value Search::Worker::search(
         // Do not return unproven mate or TB scores
         if (nullValue >= beta && nullValue < VALUE_TB_WIN_IN_MAX_PLY)
         {
+            thisThread->stats.hit(SearchStats::NullMoveCutoff);
+
             if (thisThread->nmpMinPly || depth < 16)
                 return nullValue;
 
@@ -856,7 +1117,8 @@ Value Search::Worker::search(
                   &this
                      ->continuationHistory[ss->inCheck][true][pos.moved_piece(move)][move.to_sq()];
 
-                thisThread->nodes.fetch_add(1, std::memory_order_relaxed);
+                thisThread->add_node();
+                thisThread->stats.hit(SearchStats::ProbCut);
                 pos.do_move(move, st);
 
                 // Perform a preliminary qsearch to verify that the move holds
@@ -871,6 +1133,8 @@ Value Search::Worker::search(
 
                 if (value >= probCutBeta)
                 {
+                    thisThread->stats.hit(SearchStats::ProbCutCutoff);
+
                     // Save ProbCut data into transposition table
                     tte->save(posKey, value_to_tt(value, ss->ply), ss->ttPv, BOUND_LOWER, depth - 3,
                               move, unadjustedStaticEval, tt.generation());
@@ -930,7 +1194,7 @@ moves_loop:  // When in check, search starts here
 
         ss->moveCount = ++moveCount;
 
-        if (rootNode && is_mainthread()
+        if (rootNode && is_mainthread() && !main_manager()->silent
             && main_manager()->tm.elapsed(threads.nodes_searched()) > 3000)
             sync_cout << "info depth " << depth << " currmove "
                       << UCI::move(move, pos.is_chess960()) << " currmovenumber "
@@ -972,7 +1236,10 @@ moves_loop:  // When in check, search starts here
                       + thisThread->captureHistory[movedPiece][move.to_sq()][type_of(capturedPiece)]
                           / 7;
                     if (futilityEval < alpha)
+                    {
+                        thisThread->stats.hit(SearchStats::FutilityMove);
                         continue;
+                    }
                 }
 
                 // SEE based pruning for captures and checks (~11 Elo)
@@ -1004,6 +1271,7 @@ moves_loop:  // When in check, search starts here
                     if (bestValue <= futilityValue && std::abs(bestValue) < VALUE_TB_WIN_IN_MAX_PLY
                         && futilityValue < VALUE_TB_WIN_IN_MAX_PLY)
                         bestValue = (bestValue + futilityValue * 3) / 4;
+                    thisThread->stats.hit(SearchStats::FutilityMove);
                     continue;
                 }
 
@@ -1107,7 +1375,7 @@ moves_loop:  // When in check, search starts here
         uint64_t nodeCount = rootNode ? uint64_t(nodes) : 0;
 
         // Step 16. Make the move
-        thisThread->nodes.fetch_add(1, std::memory_order_relaxed);
+        thisThread->add_node();
         pos.do_move(move, st, givesCheck);
 
         // Decrease reduction if position is or has been on the PV (~7 Elo)
@@ -1153,6 +1421,7 @@ moves_loop:  // When in check, search starts here
             // std::clamp has been replaced by a more robust implementation.
             Depth d = std::max(1, std::min(newDepth - r, newDepth + 1));
 
+            thisThread->stats.hit(SearchStats::LMRSearch);
             value = -search<NonPV>(pos, ss + 1, -(alpha + 1), -alpha, d, true);
 
             // Do a full-depth search when reduced LMR search fails high
@@ -1166,7 +1435,10 @@ moves_loop:  // When in check, search starts here
                 newDepth += doDeeperSearch - doShallowerSearch;
 
                 if (newDepth > d)
+                {
+                    thisThread->stats.hit(SearchStats::LMRResearch);
                     value = -search<NonPV>(pos, ss + 1, -(alpha + 1), -alpha, newDepth, !cutNode);
+                }
 
                 // Post LMR continuation history updates (~1 Elo)
                 int bonus = value <= alpha ? -stat_malus(newDepth)
@@ -1192,6 +1464,9 @@ moves_loop:  // When in check, search starts here
         // otherwise let the parent node fail low with value <= alpha and try another move.
         if (PvNode && (moveCount == 1 || value > alpha))
         {
+            if (moveCount > 1)
+                thisThread->stats.hit(SearchStats::PVResearch);
+
             (ss + 1)->pv    = pv;
             (ss + 1)->pv[0] = Move::none();
 
@@ -1409,6 +1684,7 @@ Value Search::Worker::qsearch(Position& pos, Stack* ss, Value alpha, Value beta,
     bestMove           = Move::none();
     ss->inCheck        = pos.checkers();
     moveCount          = 0;
+    thisThread->stats.hit(SearchStats::QSearchNode);
 
     // Used to send selDepth info to GUI (selDepth counts from 1, ply from 0)
     if (PvNode && thisThread->selDepth < ss->ply + 1)
@@ -1577,7 +1853,7 @@ Value Search::Worker::qsearch(Position& pos, Stack* ss, Value alpha, Value beta,
         quietCheckEvasions += !capture && ss->inCheck;
 
         // Step 7. Make and search the move
-        thisThread->nodes.fetch_add(1, std::memory_order_relaxed);
+        thisThread->add_node();
         pos.do_move(move, st, givesCheck);
         value = -qsearch<nodeType>(pos, ss + 1, -beta, -alpha, depth - 1);
         pos.undo_move(move);
@@ -1844,12 +2120,15 @@ void SearchManager::check_time(Search::Worker& worker) {
     // When using nodes, ensure checking rate is not lower than 0.1% of nodes
     callsCnt = worker.limits.nodes ? std::min(512, int(worker.limits.nodes / 1024)) : 512;
 
-    static TimePoint lastInfoTime = now();
+    // Keep the node count of the main thread exact for the checks below
+    worker.publish_counters();
 
     TimePoint elapsed = tm.elapsed(worker.threads.nodes_searched());
     TimePoint tick    = worker.limits.startTime + elapsed;
 
-    if (tick - lastInfoTime >= 1000)
+    // The silent pools of analyse and fixed bench, which can run next to each
+    // other, leave the debug output to the command that runs them.
+    if (!silent && tick - lastInfoTime >= 1000)
     {
         lastInfoTime = tick;
         dbg_print();
@@ -1869,11 +2148,47 @@ void SearchManager::check_time(Search::Worker& worker) {
         worker.threads.stop = worker.threads.abortedSearch = true;
 }
 
-std::string SearchManager::pv(const Search::Worker&     worker,
-                              const ThreadPool&         threads,
-                              const TranspositionTable& tt,
-                              Depth                     depth) const {
-    std::stringstream ss;
+// Sends intermediate updates at most every InfoInterval ms and, with
+// InfoOnChange, only when the depth or one of the PV lines has changed. A
+// suppressed update is remembered, so that the last one is sent before bestmove.
+bool SearchManager::info_due(const Search::Worker& worker, Depth depth) {
+
+    TimePoint interval = int(worker.options["InfoInterval"]);
+    bool      onChange = worker.options["InfoOnChange"];
+
+    if (!interval && !onChange)
+        return true;
+
+    TimePoint elapsed = tm.elapsed(worker.threads.nodes_searched());
+    uint64_t  key     = 0;
+
+    if (onChange)
+    {
+        size_t multiPV = std::min(size_t(worker.options["MultiPV"]), worker.rootMoves.size());
+
+        key = uint64_t(depth) + 1;
+        for (size_t i = 0; i < multiPV; ++i)
+            for (Move m : worker.rootMoves[i].pv)
+                key = (key ^ m.raw()) * 0x9E3779B97F4A7C15ULL;
+    }
+
+    if (elapsed - lastPvTime < interval || (onChange && key == lastInfoKey))
+    {
+        infoPending = true;
+        return false;
+    }
+
+    lastPvTime  = elapsed;
+    lastInfoKey = key;
+    infoPending = false;
+    return true;
+}
+
+const std::string& SearchManager::pv(const Search::Worker&     worker,
+                                     const ThreadPool&         threads,
+                                     const TranspositionTable& tt,
+                                     Depth                     depth) {
+    std::string& out = infoBuffer;
 
     const auto  nodes     = threads.nodes_searched();
     const auto& rootMoves = worker.rootMoves;
@@ -1882,6 +2197,11 @@ std::string SearchManager::pv(const Search::Worker&     worker,
     TimePoint   time      = tm.elapsed(nodes) + 1;
     size_t      multiPV   = std::min(size_t(worker.options["MultiPV"]), rootMoves.size());
     uint64_t    tbHits    = threads.tb_hits() + (worker.tbConfig.rootInTB ? rootMoves.size() : 0);
+    bool        showWDL   = worker.options["UCI_ShowWDL"];
+    bool        chess960  = pos.is_chess960();
+    int         hashfull  = tt.hashfull();
+
+    out.clear();
 
     for (size_t i = 0; i < multiPV; ++i)
     {
@@ -1890,7 +2210,8 @@ std::string SearchManager::pv(const Search::Worker&     worker,
         if (depth == 1 && !updated && i > 0)
             continue;
 
-        Depth d = updated ? depth : std::max(1, depth - 1);
+        Depth d = updated ? (rootMoves[i].depth ? rootMoves[i].depth : depth)
+                          : std::max(1, depth - 1);
         Value v = updated ? rootMoves[i].uciScore : rootMoves[i].previousScore;
 
         if (v == -VALUE_INFINITE)
@@ -1899,26 +2220,106 @@ std::string SearchManager::pv(const Search::Worker&     worker,
         bool tb = worker.tbConfig.rootInTB && std::abs(v) <= VALUE_TB;
         v       = tb ? rootMoves[i].tbScore : v;
 
-        if (ss.rdbuf()->in_avail())  // Not at first line
-            ss << "\n";
+        if (!out.empty())  // Not at first line
+            out += '\n';
 
-        ss << "info"
-           << " depth " << d << " seldepth " << rootMoves[i].selDepth << " multipv " << i + 1
-           << " score " << UCI::to_score(v, pos);
+        out += "info depth ";
+        UCI::append_number(out, d);
+        out += " seldepth ";
+        UCI::append_number(out, rootMoves[i].selDepth);
+        out += " multipv ";
+        UCI::append_number(out, i + 1);
+        out += " score ";
+        UCI::append_score(out, v, pos);
 
-        if (worker.options["UCI_ShowWDL"])
-            ss << UCI::wdl(v, pos);
+        if (showWDL)
+            UCI::append_wdl(out, v, pos);
 
         if (i == pvIdx && !tb && updated)  // tablebase- and previous-scores are exact
-            ss << (rootMoves[i].scoreLowerbound
-                     ? " lowerbound"
-                     : (rootMoves[i].scoreUpperbound ? " upperbound" : ""));
-
-        ss << " nodes " << nodes << " nps " << nodes * 1000 / time << " hashfull " << tt.hashfull()
-           << " tbhits " << tbHits << " time " << time << " pv";
+            out += rootMoves[i].scoreLowerbound
+                   ? " lowerbound"
+                   : (rootMoves[i].scoreUpperbound ? " upperbound" : "");
+
+        out += " nodes ";
+        UCI::append_number(out, nodes);
+        out += " nps ";
+        UCI::append_number(out, nodes * 1000 / time);
+        out += " hashfull ";
+        UCI::append_number(out, hashfull);
+        out += " tbhits ";
+        UCI::append_number(out, tbHits);
+        out += " time ";
+        UCI::append_number(out, time);
+        out += " pv";
 
         for (Move m : rootMoves[i].pv)
-            ss << " " << UCI::move(m, pos.is_chess960());
+        {
+            out += ' ';
+            UCI::append_move(out, m, chess960);
+        }
+    }
+
+    return out;
+}
+
+SearchStats& SearchStats::operator+=(const SearchStats& s) {
+
+    for (int i = 0; i < COUNTER_NB; ++i)
+        counters[i] += s.counters[i];
+
+    for (int i = 0; i < MAX_PLY; ++i)
+    {
+        plyNodes[i] += s.plyNodes[i];
+        depthNodes[i] += s.depthNodes[i];
+        iterationNodes[i] += s.iterationNodes[i];
+    }
+
+    return *this;
+}
+
+std::string SearchStats::report() const {
+
+    if (!Enabled)
+        return "Search statistics not collected, build with 'make searchstats=yes'";
+
+    std::stringstream ss;
+    uint64_t          nodes = 0;
+
+    for (uint64_t n : plyNodes)
+        nodes += n;
+
+    auto pct = [](uint64_t n, uint64_t d) { return d ? 100.0 * n / d : 0.0; };
+
+    const uint64_t* c     = counters;
+    uint64_t        total = nodes + c[QSearchNode];
+
+    ss << std::fixed << std::setprecision(2) << "Search nodes    : " << nodes
+       << "\nQSearch nodes   : " << c[QSearchNode] << " (" << pct(c[QSearchNode], total)
+       << "%)\nTT cutoffs      : " << c[TTCutoff] << " of " << c[TTProbe] << " probes ("
+       << pct(c[TTCutoff], c[TTProbe]) << "%)\nNull move       : " << c[NullMove] << ", "
+       << c[NullMoveCutoff] << " fail high (" << pct(c[NullMoveCutoff], c[NullMove])
+       << "%)\nProbCut         : " << c[ProbCut] << ", " << c[ProbCutCutoff] << " cutoffs ("
+       << pct(c[ProbCutCutoff], c[ProbCut]) << "%)\nFutility        : " << c[FutilityNode]
+       << " nodes, " << c[FutilityMove] << " moves\nLMR             : " << c[LMRSearch] << ", "
+       << c[LMRResearch] << " re-searched (" << pct(c[LMRResearch], c[LMRSearch])
+       << "%)\nPV re-searches  : " << c[PVResearch]
+       << "\nAspiration      : " << c[AspirationResearch] << " re-searches\n\n"
+       << std::setw(5) << "N" << std::setw(16) << "nodes at ply N" << std::setw(8) << "%"
+       << std::setw(16) << "at depth N" << std::setw(8) << "%" << std::setw(16) << "iteration N"
+       << std::setw(8) << "EBF";
+
+    for (int i = 0; i < MAX_PLY; ++i)
+    {
+        if (!plyNodes[i] && !depthNodes[i] && !iterationNodes[i])
+            continue;
+
+        uint64_t prev = i > 0 ? iterationNodes[i - 1] : 0;
+
+        ss << "\n"
+           << std::setw(5) << i << std::setw(16) << plyNodes[i] << std::setw(8)
+           << pct(plyNodes[i], nodes) << std::setw(16) << depthNodes[i] << std::setw(8)
+           << pct(depthNodes[i], nodes) << std::setw(16) << iterationNodes[i] << std::setw(8)
+           << (prev ? double(iterationNodes[i]) / prev : 0.0);
     }
 
     return ss.str();
@@ -19,12 +19,14 @@
 #ifndef SEARCH_H_INCLUDED
 #define SEARCH_H_INCLUDED
 
+#include <algorithm>
 #include <array>
 #include <atomic>
 #include <cassert>
 #include <cstddef>
 #include <cstdint>
 #include <memory>
+#include <mutex>
 #include <string>
 #include <vector>
 
@@ -97,6 +99,7 @@ struct RootMove {
     bool              scoreLowerbound = false;
     bool              scoreUpperbound = false;
     int               selDepth        = 0;
+    Depth             depth           = 0;  // Of a line merged from a PV group
     int               tbRank          = 0;
     Value             tbScore;
     std::vector<Move> pv;
@@ -146,6 +149,88 @@ struct SharedState {
     const Eval::NNUE::Networks& networks;
 };
 
+// SearchResult is filled in by the main thread at the end of every search with
+// the best line found, so that internal drivers can use it without parsing the
+// UCI output.
+struct SearchResult {
+    std::vector<Move> pv;
+    Value             score    = VALUE_NONE;
+    Depth             depth    = 0;
+    int               selDepth = 0;
+    uint64_t          nodes    = 0;
+    TimePoint         time     = 0;
+};
+
+// SearchStats counts where the nodes of a search go, per worker. It is only
+// collected in builds made with 'make searchstats=yes', otherwise all its
+// updates compile to nothing. Read them with the 'searchstats' command.
+struct SearchStats {
+
+#ifdef SEARCH_STATS
+    static constexpr bool Enabled = true;
+#else
+    static constexpr bool Enabled = false;
+#endif
+
+    enum Counter {
+        TTProbe,
+        TTCutoff,
+        NullMove,
+        NullMoveCutoff,
+        ProbCut,
+        ProbCutCutoff,
+        FutilityNode,
+        FutilityMove,
+        LMRSearch,
+        LMRResearch,
+        PVResearch,
+        AspirationResearch,
+        QSearchNode,
+        COUNTER_NB
+    };
+
+    void hit(Counter c) {
+        if constexpr (Enabled)
+            ++counters[c];
+    }
+
+    void node(int ply, Depth depth) {
+        if constexpr (Enabled)
+        {
+            ++plyNodes[std::min(ply, MAX_PLY - 1)];
+            ++depthNodes[std::clamp(depth, 0, MAX_PLY - 1)];
+        }
+    }
+
+    void iteration(Depth depth, uint64_t nodes) {
+        if constexpr (Enabled)
+            iterationNodes[depth] += nodes;
+    }
+
+    void         clear() { *this = SearchStats(); }
+    SearchStats& operator+=(const SearchStats& s);
+    std::string  report() const;
+
+    uint64_t counters[COUNTER_NB]   = {};
+    uint64_t plyNodes[MAX_PLY]       = {};
+    uint64_t depthNodes[MAX_PLY]     = {};
+    uint64_t iterationNodes[MAX_PLY] = {};
+};
+
+// MultiPVLines is where, with the MultiPVSplit option, the thread groups that
+// search different PV lines publish them. Each thread merges the lines of the
+// other groups into its root moves at the end of every iteration.
+struct MultiPVLines {
+    void clear() {
+        lines.clear();
+        depths.clear();
+    }
+
+    std::mutex            mutex;
+    std::vector<RootMove> lines;
+    std::vector<Depth>    depths;
+};
+
 class Worker;
 
 // Null Object Pattern, implement a common interface for the SearchManagers.
@@ -162,10 +247,14 @@ class SearchManager: public ISearchManager {
    public:
     void check_time(Search::Worker& worker) override;
 
-    std::string pv(const Search::Worker&     worker,
-                   const ThreadPool&         threads,
-                   const TranspositionTable& tt,
-                   Depth                     depth) const;
+    const std::string& pv(const Search::Worker&     worker,
+                          const ThreadPool&         threads,
+                          const TranspositionTable& tt,
+                          Depth                     depth);
+
+    // Whether an intermediate info update should be sent now, see the
+    // InfoInterval and InfoOnChange options
+    bool info_due(const Search::Worker& worker, Depth depth);
 
     Stockfish::TimeManagement tm;
     int                       callsCnt;
@@ -176,6 +265,17 @@ class SearchManager: public ISearchManager {
     Value                bestPreviousScore;
     Value                bestPreviousAverageScore;
     bool                 stopOnPonderhit;
+    TimePoint            lastInfoTime = now();  // Last dbg_print() by check_time()
+
+    // A silent search sends neither info nor bestmove lines
+    bool         silent = false;
+    SearchResult result;
+
+    // Reused by pv() so that formatting info lines doesn't allocate
+    std::string infoBuffer;
+    TimePoint   lastPvTime;
+    uint64_t    lastInfoKey;
+    bool        infoPending;
 
     size_t id;
 };
@@ -211,6 +311,16 @@ class Worker {
     PawnHistory           pawnHistory;
     CorrectionHistory     correctionHistory;
 
+    // Hardware counters of this thread, enabled by bench
+    PerfCounters perf;
+
+    // Search tree statistics of this thread, see SearchStats
+    SearchStats stats;
+
+    // Adds the nodes and tablebase hits counted since the last call to the
+    // totals of the thread pool.
+    void publish_counters();
+
    private:
     void iterative_deepening();
 
@@ -224,6 +334,13 @@ class Worker {
 
     Depth reduction(bool i, Depth d, int mn, int delta);
 
+    // Share the PV lines of the thread groups, see MultiPVLines
+    void  publish_line(size_t idx);
+    Depth min_line_depth(size_t multiPV);
+    void  wait_for_lines(size_t multiPV, Depth d);
+    void  search_missing_lines(Stack* ss, size_t multiPV);
+    void  merge_lines(size_t multiPV);
+
     // Get a pointer to the search manager, only allowed to be called by the
     // main thread.
     SearchManager* main_manager() const {
@@ -233,14 +350,24 @@ class Worker {
 
     LimitsType limits;
 
+    // The nodes and tablebase hits of this thread are plain counters, written
+    // only by the thread itself. They are published every PublishInterval
+    // nodes, so that the readers never touch the cache line they live on.
+    static constexpr uint64_t PublishInterval = 4096;
+
+    void add_node() {
+        if ((++nodes & (PublishInterval - 1)) == 0)
+            publish_counters();
+    }
+
     size_t                pvIdx, pvLast;
-    std::atomic<uint64_t> nodes, tbHits, bestMoveChanges;
+    uint64_t              nodes, tbHits, publishedNodes, publishedTbHits;
+    std::atomic<uint64_t> bestMoveChanges;
     int                   selDepth, nmpMinPly;
 
     Value optimism[COLOR_NB];
 
     Position  rootPos;
-    StateInfo rootState;
     RootMoves rootMoves;
     Depth     rootDepth, completedDepth;
     Value     rootDelta;
@@ -21,17 +21,21 @@
 #include <algorithm>
 #include <atomic>
 #include <cassert>
+#include <chrono>
+#include <condition_variable>
 #include <cstdint>
 #include <cstdlib>
 #include <cstring>
 #include <deque>
 #include <fstream>
 #include <initializer_list>
+#include <iomanip>
 #include <iostream>
 #include <mutex>
 #include <sstream>
 #include <string_view>
 #include <sys/stat.h>
+#include <thread>
 #include <type_traits>
 #include <utility>
 #include <vector>
@@ -41,6 +45,7 @@
 #include "../movegen.h"
 #include "../position.h"
 #include "../search.h"
+#include "../thread.h"
 #include "../types.h"
 #include "../ucioption.h"
 
@@ -65,6 +70,8 @@ namespace Stockfish {
 namespace {
 
 constexpr int TBPIECES = 7;  // Max number of supported pieces
+constexpr int PrefetchCaptures = 3;  // Prefetch tables up to this number of captures away
+constexpr int SlowProbeNs = 50000;  // Slower probes are assumed to have waited for the disk
 constexpr int MAX_DTZ =
   1 << 18;  // Max DTZ supported, large enough to deal with the syzygy TB limit.
 
@@ -199,7 +206,8 @@ class TBFile: public std::ifstream {
     //
     // Example:
     // C:\tb\wdl345;C:\tb\wdl6;D:\tb\dtz345;D:\tb\dtz6
-    static std::string Paths;
+    static std::string            Paths;
+    static std::atomic<MapPolicy> Policy;
 
     TBFile(const std::string& f) {
 
@@ -240,11 +248,20 @@ class TBFile: public std::ifstream {
             exit(EXIT_FAILURE);
         }
 
-        *mapping     = statbuf.st_size;
-        *baseAddress = mmap(nullptr, statbuf.st_size, PROT_READ, MAP_SHARED, fd, 0);
-    #if defined(MADV_RANDOM)
-        madvise(*baseAddress, statbuf.st_size, MADV_RANDOM);
+        // Probes are scattered, so by default the kernel read-ahead mostly loads
+        // pages that will never be touched.
+        MapPolicy policy = Policy;
+        int       flags  = MAP_SHARED;
+
+        if (policy == MapAuto)
+            policy = MapRandom;
+    #if defined(MAP_POPULATE)
+        if (policy == MapPopulate)
+            flags |= MAP_POPULATE;
     #endif
+
+        *mapping     = statbuf.st_size;
+        *baseAddress = mmap(nullptr, statbuf.st_size, PROT_READ, flags, fd, 0);
         ::close(fd);
 
         if (*baseAddress == MAP_FAILED)
@@ -252,6 +269,15 @@ class TBFile: public std::ifstream {
             std::cerr << "Could not mmap() " << fname << std::endl;
             exit(EXIT_FAILURE);
         }
+
+    #if defined(MADV_RANDOM)
+        if (policy == MapRandom)
+            madvise(*baseAddress, statbuf.st_size, MADV_RANDOM);
+    #endif
+    #if defined(MADV_WILLNEED)
+        if (policy == MapWillNeed)
+            madvise(*baseAddress, statbuf.st_size, MADV_WILLNEED);
+    #endif
 #else
         // Note FILE_FLAG_RANDOM_ACCESS is only a hint to Windows and as such may get ignored.
         HANDLE fd = CreateFileA(fname.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
@@ -313,7 +339,53 @@ class TBFile: public std::ifstream {
     }
 };
 
-std::string TBFile::Paths;
+std::string            TBFile::Paths;
+std::atomic<MapPolicy> TBFile::Policy = MapAuto;
+
+#ifndef _WIN32
+uintptr_t page_size() {
+    static const uintptr_t PageSize = uintptr_t(sysconf(_SC_PAGESIZE));
+    return PageSize;
+}
+#endif
+
+// Asks the kernel to read ahead the pages of a mapped range, without waiting
+// for them. This is only a hint, a no-op where not supported.
+void will_need(const void* addr, size_t size) {
+
+#if !defined(_WIN32) && defined(MADV_WILLNEED)
+    uintptr_t begin = uintptr_t(addr) & ~(page_size() - 1);
+    madvise((void*) begin, uintptr_t(addr) + size - begin, MADV_WILLNEED);
+#else
+    (void) addr;
+    (void) size;
+#endif
+}
+
+// Returns true if all the pages of a mapped range are in memory, so that reading
+// it will not block on disk I/O. Where this can't be known, assume they are.
+bool in_core(const void* addr, size_t size) {
+
+#if defined(__linux__)
+    constexpr size_t MaxPages = 4;
+    unsigned char    vec[MaxPages];
+
+    uintptr_t begin = uintptr_t(addr) & ~(page_size() - 1);
+    size_t    len   = uintptr_t(addr) + size - begin;
+
+    if ((len + page_size() - 1) / page_size() > MaxPages || mincore((void*) begin, len, vec))
+        return true;
+
+    for (size_t i = 0; i < (len + page_size() - 1) / page_size(); ++i)
+        if (!(vec[i] & 1))
+            return false;
+#else
+    (void) addr;
+    (void) size;
+#endif
+
+    return true;
+}
 
 // struct PairsData contains low-level indexing information to access TB data.
 // There are 8, 4, or 2 PairsData records for each TBTable, according to the type
@@ -342,6 +414,176 @@ struct PairsData {
     uint16_t map_idx[4];              // WDLWin, WDLLoss, WDLCursedWin, WDLBlessedLoss (used in DTZ)
 };
 
+// class BlockCache keeps the symbol sequences of recently decompressed blocks,
+// so that a probe into a cached block needs a binary search over the block's
+// symbols instead of Huffman decoding the block from its beginning. Slots are
+// tagged by PairsData record and block number, so tables don't mix. The cache
+// is split into shards, each one guarded by its own spinlock. A busy shard is
+// simply bypassed: probing never waits for the cache. Only blocks with up to
+// MaxSymbols symbols, that covers most of the WDL blocks, are cached.
+class BlockCache {
+
+    static constexpr int ShardsNum = 64;
+
+   public:
+    static constexpr int MaxSymbols = 256;
+
+   private:
+    struct Slot {
+        const PairsData* d;
+        uint32_t         block;
+        int              count;
+        uint16_t         start[MaxSymbols];  // Offset in the block of each symbol's first value
+        Sym              sym[MaxSymbols];
+    };
+
+    struct alignas(64) Shard {
+        std::atomic_bool busy{false};
+        uint64_t         hits = 0, misses = 0;  // Updated under the lock
+
+        bool try_lock() { return !busy.exchange(true, std::memory_order_acquire); }
+        void unlock() { busy.store(false, std::memory_order_release); }
+    };
+
+    Slot& slot(const PairsData* d, uint32_t block, Shard*& shard) {
+        uint64_t h   = (uint64_t(uintptr_t(d)) ^ (uint64_t(block) << 20)) * 0x9E3779B97F4A7C15ULL;
+        size_t   idx = size_t(mul_hi64(h, slots.size()));
+        shard        = &shards[idx % ShardsNum];
+        return slots[idx];
+    }
+
+    Shard             shards[ShardsNum];
+    std::vector<Slot> slots;
+    size_t            mbSize = 0;
+
+   public:
+    bool enabled() const { return !slots.empty(); }
+
+    // Looks up the block and, if found, sets the symbol holding the value at
+    // the given offset and makes offset relative to the start of that symbol.
+    bool probe(const PairsData* d, uint32_t block, int& offset, Sym& sym) {
+
+        if (slots.empty())
+            return false;
+
+        Shard* shard;
+        Slot&  s = slot(d, block, shard);
+
+        if (!shard->try_lock())
+            return false;
+
+        bool hit = s.d == d && s.block == block;
+
+        ++(hit ? shard->hits : shard->misses);
+
+        if (hit)
+        {
+            // Last symbol starting at or before our offset
+            int i = int(std::upper_bound(s.start, s.start + s.count, offset) - s.start) - 1;
+            sym   = s.sym[i];
+            offset -= s.start[i];
+        }
+
+        shard->unlock();
+        return hit;
+    }
+
+    void store(const PairsData* d,
+               uint32_t         block,
+               int              count,
+               const uint16_t*  start,
+               const Sym*       sym) {
+
+        assert(count <= MaxSymbols);
+
+        if (slots.empty())
+            return;
+
+        Shard* shard;
+        Slot&  s = slot(d, block, shard);
+
+        if (!shard->try_lock())
+            return;
+
+        s.d     = d;
+        s.block = block;
+        s.count = count;
+        std::memcpy(s.start, start, count * sizeof(uint16_t));
+        std::memcpy(s.sym, sym, count * sizeof(Sym));
+
+        shard->unlock();
+    }
+
+    // Sets the cache size in MB. Slots are allocated only while some
+    // tables are available, otherwise the cache just stays empty.
+    void resize(size_t mb, bool tablesFound) {
+        mbSize = mb;
+        slots.clear();
+        slots.shrink_to_fit();
+
+        if (tablesFound && mbSize)
+            slots.resize(mbSize * 1024 * 1024 / sizeof(Slot), Slot());
+    }
+
+    // PairsData records are going to be freed, drop all the slots
+    void clear(bool tablesFound) { resize(mbSize, tablesFound); }
+
+    // Sums the hit and miss counters of all the shards, optionally resetting them
+    std::pair<uint64_t, uint64_t> stats(bool reset) {
+        uint64_t hits = 0, misses = 0;
+
+        for (Shard& shard : shards)
+        {
+            while (!shard.try_lock())
+            {}
+
+            hits += shard.hits;
+            misses += shard.misses;
+
+            if (reset)
+                shard.hits = shard.misses = 0;
+
+            shard.unlock();
+        }
+        return {hits, misses};
+    }
+};
+
+BlockCache BlockCache;
+
+// struct ProbeStats collects the probes of a table by all the search threads,
+// to tell which tables are worth keeping on fast storage. The probes are only
+// timed and counted in builds made with 'make tbstats=yes', as the shared
+// counters of a hot table would otherwise be contended by all the threads.
+struct ProbeStats {
+
+#ifdef TB_STATS
+    static constexpr bool Enabled = true;
+#else
+    static constexpr bool Enabled = false;
+#endif
+
+    std::atomic<uint64_t> probes{0};    // Total number of probes
+    std::atomic<uint64_t> slow{0};      // Probes that likely waited for the disk
+    std::atomic<uint64_t> deferred{0};  // Non-blocking probes failed on missing pages
+    std::atomic<uint64_t> nanoseconds{0};
+
+    void add(int64_t ns, bool failed) {
+        if constexpr (!Enabled)
+            return;
+
+        probes.fetch_add(1, std::memory_order_relaxed);
+        nanoseconds.fetch_add(ns, std::memory_order_relaxed);
+
+        if (ns > SlowProbeNs)
+            slow.fetch_add(1, std::memory_order_relaxed);
+        if (failed)
+            deferred.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void clear() { probes = slow = deferred = nanoseconds = 0; }
+};
+
 // struct TBTable contains indexing information to access the corresponding TBFile.
 // There are 2 types of TBTable, corresponding to a WDL or a DTZ file. TBTable
 // is populated at init time but the nested PairsData records are populated at
@@ -352,7 +594,10 @@ struct TBTable {
 
     static constexpr int Sides = Type == WDL ? 2 : 1;
 
-    std::atomic_bool ready;
+    std::atomic_bool ready, prefetched;
+    std::mutex       mutex;  // Serializes the first access, see mapped()
+    std::string      code;   // Like KRvK, the stronger side first
+    ProbeStats       stats;
     void*            baseAddress;
     uint8_t*         map;
     uint64_t         mapping;
@@ -368,20 +613,29 @@ struct TBTable {
 
     TBTable() :
         ready(false),
+        prefetched(false),
         baseAddress(nullptr) {}
-    explicit TBTable(const std::string& code);
+    explicit TBTable(const std::string& name);
     explicit TBTable(const TBTable<WDL>& wdl);
 
-    ~TBTable() {
+    ~TBTable() { unmap(); }
+
+    // Free the mapped file, it will be mapped again at next access
+    void unmap() {
         if (baseAddress)
             TBFile::unmap(baseAddress, mapping);
+
+        baseAddress = nullptr;
+        ready = prefetched = false;
     }
 };
 
 template<>
-TBTable<WDL>::TBTable(const std::string& code) :
+TBTable<WDL>::TBTable(const std::string& name) :
     TBTable() {
 
+    code = name;
+
     StateInfo st;
     Position  pos;
 
@@ -411,6 +665,7 @@ TBTable<DTZ>::TBTable(const TBTable<WDL>& wdl) :
     TBTable() {
 
     // Use the corresponding WDL table to avoid recalculating all from scratch
+    code            = wdl.code;
     key             = wdl.key;
     key2            = wdl.key2;
     pieceCount      = wdl.pieceCount;
@@ -487,29 +742,35 @@ class TBTables {
         wdlTable.clear();
         dtzTable.clear();
     }
+    void unmap() {
+        for (auto& e : wdlTable)
+            e.unmap();
+        for (auto& e : dtzTable)
+            e.unmap();
+    }
+    template<TBType Type, typename Func>
+    void for_each(Func f) {
+        if constexpr (Type == WDL)
+            for (auto& e : wdlTable)
+                f(e);
+        else
+            for (auto& e : dtzTable)
+                f(e);
+    }
     size_t size() const { return wdlTable.size(); }
-    void   add(const std::vector<PieceType>& pieces);
+    void   add(const std::string& code, int pieceCount);
 };
 
 TBTables TBTables;
 
-// If the corresponding file exists two new objects TBTable<WDL> and TBTable<DTZ>
-// are created and added to the lists and hash table. Called at init time.
-void TBTables::add(const std::vector<PieceType>& pieces) {
-
-    std::string code;
+ProbeStats RootRanking;  // Calls of rank_root_moves() that probed the tables
 
-    for (PieceType pt : pieces)
-        code += PieceToChar[pt];
+// Two new objects TBTable<WDL> and TBTable<DTZ> are created for the table with
+// the given code, like KRvK, and added to the lists and hash table. Called at
+// init time for each found file.
+void TBTables::add(const std::string& code, int pieceCount) {
 
-    TBFile file(code.insert(code.find('K', 1), "v") + ".rtbw");  // KRK -> KRvK
-
-    if (!file.is_open())  // Only WDL file is checked
-        return;
-
-    file.close();
-
-    MaxCardinality = std::max(int(pieces.size()), MaxCardinality);
+    MaxCardinality = std::max(pieceCount, MaxCardinality);
 
     wdlTable.emplace_back(code);
     dtzTable.emplace_back(wdlTable.back());
@@ -519,26 +780,9 @@ void TBTables::add(const std::vector<PieceType>& pieces) {
     insert(wdlTable.back().key2, &wdlTable.back(), &dtzTable.back());
 }
 
-// TB tables are compressed with canonical Huffman code. The compressed data is divided into
-// blocks of size d->sizeofBlock, and each block stores a variable number of symbols.
-// Each symbol represents either a WDL or a (remapped) DTZ value, or a pair of other symbols
-// (recursively). If you keep expanding the symbols in a block, you end up with up to 65536
-// WDL or DTZ values. Each symbol represents up to 256 values and will correspond after
-// Huffman coding to at least 1 bit. So a block of 32 bytes corresponds to at most
-// 32 x 8 x 256 = 65536 values. This maximum is only reached for tables that consist mostly
-// of draws or mostly of wins, but such tables are actually quite common. In principle, the
-// blocks in WDL tables are 64 bytes long (and will be aligned on cache lines). But for
-// mostly-draw or mostly-win tables this can leave many 64-byte blocks only half-filled, so
-// in such cases blocks are 32 bytes long. The blocks of DTZ tables are up to 1024 bytes long.
-// The generator picks the size that leads to the smallest table. The "book" of symbols and
-// Huffman codes are the same for all blocks in the table. A non-symmetric pawnless TB file
-// will have one table for wtm and one for btm, a TB file with pawns will have tables per
-// file a,b,c,d also, in this case, one set for wtm and one for btm.
-int decompress_pairs(PairsData* d, uint64_t idx) {
-
-    // Special case where all table positions store the same value
-    if (d->flags & TBFlag::SingleValue)
-        return d->minSymLen;
+// Returns the block that stores the value at index idx, and sets offset to the
+// position of the value within the block.
+uint32_t find_block(PairsData* d, uint64_t idx, int& offset) {
 
     // First we need to locate the right block that stores the value at index "idx".
     // Because each block n stores blockLength[n] + 1 values, the index i of the block
@@ -558,8 +802,8 @@ int decompress_pairs(PairsData* d, uint64_t idx) {
     uint32_t k = uint32_t(idx / d->span);
 
     // Then we read the corresponding SparseIndex[] entry
-    uint32_t block  = number<uint32_t, LittleEndian>(&d->sparseIndex[k].block);
-    int      offset = number<uint16_t, LittleEndian>(&d->sparseIndex[k].offset);
+    uint32_t block = number<uint32_t, LittleEndian>(&d->sparseIndex[k].block);
+    offset         = number<uint16_t, LittleEndian>(&d->sparseIndex[k].offset);
 
     // Now compute the difference idx - I(k). From the definition of k, we know that
     //
@@ -579,51 +823,146 @@ int decompress_pairs(PairsData* d, uint64_t idx) {
     while (offset > d->blockLength[block])
         offset -= d->blockLength[block++] + 1;
 
-    // Finally, we find the start address of our block of canonical Huffman symbols
-    uint32_t* ptr = (uint32_t*) (d->data + (uint64_t(block) * d->sizeofBlock));
+    return block;
+}
+
+// Returns true if decompressing the value at index idx is not going to block on
+// page faults. Otherwise the missing pages are requested in the background, so
+// that a later probe will find them in memory.
+bool resident(PairsData* d, uint64_t idx) {
+
+    if (d->flags & TBFlag::SingleValue)
+        return true;
+
+    SparseEntry* entry = &d->sparseIndex[idx / d->span];
+    uint32_t     block;
+    int          offset;
+
+    if (!in_core(entry, sizeof(SparseEntry)))
+        return will_need(entry, sizeof(SparseEntry)), false;
+
+    // Walking blockLength[] from the sparse entry usually stays on the same page
+    block = number<uint32_t, LittleEndian>(&entry->block);
+
+    if (!in_core(&d->blockLength[block], sizeof(uint16_t)))
+        return will_need(&d->blockLength[block], sizeof(uint16_t)), false;
+
+    block = find_block(d, idx, offset);
+
+    uint8_t* data = d->data + uint64_t(block) * d->sizeofBlock;
+
+    if (!in_core(data, d->sizeofBlock))
+        return will_need(data, d->sizeofBlock), false;
+
+    return true;
+}
+
+// TB tables are compressed with canonical Huffman code. The compressed data is divided into
+// blocks of size d->sizeofBlock, and each block stores a variable number of symbols.
+// Each symbol represents either a WDL or a (remapped) DTZ value, or a pair of other symbols
+// (recursively). If you keep expanding the symbols in a block, you end up with up to 65536
+// WDL or DTZ values. Each symbol represents up to 256 values and will correspond after
+// Huffman coding to at least 1 bit. So a block of 32 bytes corresponds to at most
+// 32 x 8 x 256 = 65536 values. This maximum is only reached for tables that consist mostly
+// of draws or mostly of wins, but such tables are actually quite common. In principle, the
+// blocks in WDL tables are 64 bytes long (and will be aligned on cache lines). But for
+// mostly-draw or mostly-win tables this can leave many 64-byte blocks only half-filled, so
+// in such cases blocks are 32 bytes long. The blocks of DTZ tables are up to 1024 bytes long.
+// The generator picks the size that leads to the smallest table. The "book" of symbols and
+// Huffman codes are the same for all blocks in the table. A non-symmetric pawnless TB file
+// will have one table for wtm and one for btm, a TB file with pawns will have tables per
+// file a,b,c,d also, in this case, one set for wtm and one for btm.
+int decompress_pairs(PairsData* d, uint64_t idx) {
+
+    // Special case where all table positions store the same value
+    if (d->flags & TBFlag::SingleValue)
+        return d->minSymLen;
+
+    int      offset;
+    uint32_t block = find_block(d, idx, offset);
 
-    // Read the first 64 bits in our block, this is a (truncated) sequence of
-    // unknown number of symbols of unknown length but we know the first one
-    // is at the beginning of this 64-bit sequence.
-    uint64_t buf64 = number<uint64_t, BigEndian>(ptr);
-    ptr += 2;
-    int buf64Size = 64;
     Sym sym;
 
-    while (true)
+    // Recently decoded blocks are looked up in the block cache first. On a hit
+    // we get our symbol and the offset within it without touching the block.
+    if (!BlockCache.probe(d, block, offset, sym))
     {
-        int len = 0;  // This is the symbol length - d->min_sym_len
-
-        // Now get the symbol length. For any symbol s64 of length l right-padded
-        // to 64 bits we know that d->base64[l-1] >= s64 >= d->base64[l] so we
-        // can find the symbol length iterating through base64[].
-        while (buf64 < d->base64[len])
-            ++len;
-
-        // All the symbols of a given length are consecutive integers (numerical
-        // sequence property), so we can compute the offset of our symbol of
-        // length len, stored at the beginning of buf64.
-        sym = Sym((buf64 - d->base64[len]) >> (64 - len - d->minSymLen));
-
-        // Now add the value of the lowest symbol of length len to get our symbol
-        sym += number<Sym, LittleEndian>(&d->lowestSym[len]);
-
-        // If our offset is within the number of values represented by symbol sym,
-        // we are done.
-        if (offset < d->symlen[sym] + 1)
-            break;
-
-        // ...otherwise update the offset and continue to iterate
-        offset -= d->symlen[sym] + 1;
-        len += d->minSymLen;  // Get the real length
-        buf64 <<= len;        // Consume the just processed symbol
-        buf64Size -= len;
-
-        if (buf64Size <= 32)
-        {  // Refill the buffer
-            buf64Size += 32;
-            buf64 |= uint64_t(number<uint32_t, BigEndian>(ptr++)) << (64 - buf64Size);
+        // Finally, we find the start address of our block of canonical Huffman symbols
+        uint32_t* ptr = (uint32_t*) (d->data + (uint64_t(block) * d->sizeofBlock));
+
+        // Read the first 64 bits in our block, this is a (truncated) sequence of
+        // unknown number of symbols of unknown length but we know the first one
+        // is at the beginning of this 64-bit sequence.
+        uint64_t buf64 = number<uint64_t, BigEndian>(ptr);
+        ptr += 2;
+        int buf64Size = 64;
+
+        // When the cache is in use we decode the whole block, recording where
+        // each symbol starts, so that the next probes into this block can be
+        // served from the cache. 'found' is set once we have reached our symbol.
+        bool     record = BlockCache.enabled();
+        bool     found  = false;
+        int      count = 0, start = 0, last = d->blockLength[block];
+        uint16_t starts[BlockCache::MaxSymbols];
+        Sym      syms[BlockCache::MaxSymbols], s;
+
+        while (true)
+        {
+            int len = 0;  // This is the symbol length - d->min_sym_len
+
+            // Now get the symbol length. For any symbol s64 of length l right-padded
+            // to 64 bits we know that d->base64[l-1] >= s64 >= d->base64[l] so we
+            // can find the symbol length iterating through base64[].
+            while (buf64 < d->base64[len])
+                ++len;
+
+            // All the symbols of a given length are consecutive integers (numerical
+            // sequence property), so we can compute the offset of our symbol of
+            // length len, stored at the beginning of buf64.
+            s = Sym((buf64 - d->base64[len]) >> (64 - len - d->minSymLen));
+
+            // Now add the value of the lowest symbol of length len to get our symbol
+            s += number<Sym, LittleEndian>(&d->lowestSym[len]);
+
+            if (record)
+            {
+                if (count < BlockCache::MaxSymbols)
+                    starts[count] = uint16_t(start), syms[count++] = s;
+                else
+                    record = false;  // Too many symbols, the block won't be cached
+            }
+
+            // If our offset is within the number of values represented by symbol s,
+            // we are done, unless we are still decoding the block for the cache.
+            if (!found && offset < d->symlen[s] + 1)
+            {
+                sym   = s;
+                found = true;
+            }
+
+            start += d->symlen[s] + 1;
+
+            // Stop at our symbol or, when decoding the whole block, at its last one
+            if (found && (!record || start > last))
+                break;
+
+            // ...otherwise update the offset and continue to iterate
+            if (!found)
+                offset -= d->symlen[s] + 1;
+
+            len += d->minSymLen;  // Get the real length
+            buf64 <<= len;        // Consume the just processed symbol
+            buf64Size -= len;
+
+            if (buf64Size <= 32)
+            {  // Refill the buffer
+                buf64Size += 32;
+                buf64 |= uint64_t(number<uint32_t, BigEndian>(ptr++)) << (64 - buf64Size);
+            }
         }
+
+        if (record)
+            BlockCache.store(d, block, count, starts, syms);
     }
 
     // Now we have our symbol that expands into d->symlen[sym] + 1 symbols.
@@ -708,8 +1047,8 @@ int map_score(TBTable<DTZ>* entry, File f, int value, WDLScore wdl) {
 //      idx = Binomial[1][s1] + Binomial[2][s2] + ... + Binomial[k][sk]
 //
 template<typename T, typename Ret = typename T::Ret>
-CLANG_AVX512_BUG_FIX Ret
-do_probe_table(const Position& pos, T* entry, WDLScore wdl, ProbeState* result) {
+CLANG_AVX512_BUG_FIX Ret do_probe_table(
+  const Position& pos, T* entry, WDLScore wdl, ProbeState* result, bool nonBlocking) {
 
     Square     squares[TBPIECES];
     Piece      pieces[TBPIECES];
@@ -916,6 +1255,11 @@ encode_remaining:
         groupSq += d->groupLen[next];
     }
 
+    // In non-blocking mode give up if decompressing would wait for the disk.
+    // The needed pages are then read in the background for a later probe.
+    if (nonBlocking && !resident(d, idx))
+        return *result = FAIL, Ret();
+
     // Now that we have the index, decompress the pair and get the score
     return map_score(entry, tbFile, decompress_pairs(d, idx), wdl);
 }
@@ -1193,30 +1537,21 @@ void set(T& e, uint8_t* data) {
 // at every probe, memory map, and init only at first access. Function is thread
 // safe and can be called concurrently.
 template<TBType Type>
-void* mapped(TBTable<Type>& e, const Position& pos) {
-
-    static std::mutex mutex;
+void* mapped(TBTable<Type>& e) {
 
     // Use 'acquire' to avoid a thread reading 'ready' == true while
     // another is still working. (compiler reordering may cause this).
     if (e.ready.load(std::memory_order_acquire))
         return e.baseAddress;  // Could be nullptr if file does not exist
 
-    std::scoped_lock<std::mutex> lk(mutex);
+    // Each table has its own lock, so first accesses to different
+    // tables don't wait for each other.
+    std::scoped_lock<std::mutex> lk(e.mutex);
 
     if (e.ready.load(std::memory_order_relaxed))  // Recheck under lock
         return e.baseAddress;
 
-    // Pieces strings in decreasing order for each color, like ("KPP","KR")
-    std::string fname, w, b;
-    for (PieceType pt = KING; pt >= PAWN; --pt)
-    {
-        w += std::string(popcount(pos.pieces(WHITE, pt)), PieceToChar[pt]);
-        b += std::string(popcount(pos.pieces(BLACK, pt)), PieceToChar[pt]);
-    }
-
-    fname =
-      (e.key == pos.material_key() ? w + 'v' + b : b + 'v' + w) + (Type == WDL ? ".rtbw" : ".rtbz");
+    std::string fname = e.code + (Type == WDL ? ".rtbw" : ".rtbz");
 
     uint8_t* data = TBFile(fname).map(&e.baseAddress, &e.mapping, Type);
 
@@ -1227,18 +1562,150 @@ void* mapped(TBTable<Type>& e, const Position& pos) {
     return e.baseAddress;
 }
 
+// class Prefetcher maps WDL tables and reads ahead their sparse index and block
+// length data in a background thread. Tables likely to be reached from the root
+// are queued at search start, so that the first probes of a new endgame don't
+// stall the search threads on page faults. The thread is started at first use.
+class Prefetcher {
+
+    std::mutex                mutex;
+    std::condition_variable   cv;
+    std::deque<TBTable<WDL>*> queue;
+    bool                      exit = false, busy = false;
+    std::thread               thread;
+
+    void idle_loop() {
+
+        while (true)
+        {
+            std::unique_lock<std::mutex> lk(mutex);
+            busy = false;
+            cv.notify_all();  // Wake up anyone waiting in cancel()
+            cv.wait(lk, [&] { return exit || !queue.empty(); });
+
+            if (exit)
+                return;
+
+            TBTable<WDL>* e = queue.front();
+            queue.pop_front();
+            busy = true;
+            lk.unlock();
+
+            if (!mapped(*e))
+                continue;
+
+            const int sides = e->key != e->key2 ? 2 : 1;
+
+            for (int f = FILE_A; f <= (e->hasPawns ? FILE_D : FILE_A); ++f)
+                for (int i = 0; i < sides; ++i)
+                {
+                    PairsData* d = e->get(i, f);
+
+                    if (!(d->flags & TBFlag::SingleValue))
+                    {
+                        will_need(d->sparseIndex, d->sparseIndexSize * sizeof(SparseEntry));
+                        will_need(d->blockLength, d->blockLengthSize * sizeof(uint16_t));
+                    }
+                }
+        }
+    }
+
+   public:
+    ~Prefetcher() {
+        mutex.lock();
+        exit = true;
+        mutex.unlock();
+        cv.notify_all();
+
+        if (thread.joinable())
+            thread.join();
+    }
+
+    void push(TBTable<WDL>* e) {
+
+        if (e->prefetched.exchange(true))
+            return;
+
+        std::scoped_lock<std::mutex> lk(mutex);
+
+        if (!thread.joinable())
+            thread = std::thread(&Prefetcher::idle_loop, this);
+
+        queue.push_back(e);
+        cv.notify_all();
+    }
+
+    // Drops the pending requests and waits for the current one, called
+    // before the tables are unmapped or destroyed.
+    void cancel() {
+        std::unique_lock<std::mutex> lk(mutex);
+        queue.clear();
+        cv.wait(lk, [&] { return !busy; });
+    }
+};
+
+Prefetcher Prefetcher;
+
+// True if the material of the table (stronger side first, like KRPvKR) is a
+// subset of the material of the position, for either side as the stronger one.
+bool reachable(const std::string& code, const Position& pos) {
+
+    size_t v = code.find('v');
+
+    auto fits = [&](Color strong) {
+        for (PieceType pt = PAWN; pt < KING; ++pt)
+        {
+            auto n1 = std::count(code.begin(), code.begin() + v, PieceToChar[pt]);
+            auto n2 = std::count(code.begin() + v, code.end(), PieceToChar[pt]);
+
+            if (n1 > popcount(pos.pieces(strong, pt)) || n2 > popcount(pos.pieces(~strong, pt)))
+                return false;
+        }
+        return true;
+    };
+
+    return fits(WHITE) || fits(BLACK);
+}
+
 template<TBType Type, typename Ret = typename TBTable<Type>::Ret>
-Ret probe_table(const Position& pos, ProbeState* result, WDLScore wdl = WDLDraw) {
+Ret probe_table(const Position& pos,
+                ProbeState*     result,
+                WDLScore        wdl         = WDLDraw,
+                bool            nonBlocking = false) {
 
     if (pos.count<ALL_PIECES>() == 2)  // KvK
         return Ret(WDLDraw);
 
     TBTable<Type>* entry = TBTables.get<Type>(pos.material_key());
 
-    if (!entry || !mapped(*entry, pos))
+    if (!entry)
         return *result = FAIL, Ret();
 
-    return do_probe_table(pos, entry, wdl, result);
+    // In non-blocking mode a table not yet mapped is handed over to the
+    // prefetcher instead of being mapped by the calling thread.
+    if constexpr (Type == WDL)
+        if (nonBlocking && !entry->ready.load(std::memory_order_acquire))
+        {
+            Prefetcher.push(entry);
+            return *result = FAIL, Ret();
+        }
+
+    std::chrono::steady_clock::time_point start;
+
+    if constexpr (ProbeStats::Enabled)
+        start = std::chrono::steady_clock::now();
+
+    if (!mapped(*entry))
+        return *result = FAIL, Ret();
+
+    Ret value = do_probe_table(pos, entry, wdl, result, nonBlocking);
+
+    if constexpr (ProbeStats::Enabled)
+        entry->stats.add(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                           std::chrono::steady_clock::now() - start)
+                           .count(),
+                         *result == FAIL);
+    return value;
 }
 
 // For a position where the side to move has a winning capture it is not necessary
@@ -1255,7 +1722,7 @@ Ret probe_table(const Position& pos, ProbeState* result, WDLScore wdl = WDLDraw)
 // where the best move is an ep-move (even if losing). So in all these cases set
 // the state to ZEROING_BEST_MOVE.
 template<bool CheckZeroingMoves>
-WDLScore search(Position& pos, ProbeState* result) {
+WDLScore search(Position& pos, ProbeState* result, bool nonBlocking = false) {
 
     WDLScore  value, bestValue = WDLLoss;
     StateInfo st;
@@ -1271,7 +1738,7 @@ WDLScore search(Position& pos, ProbeState* result) {
         moveCount++;
 
         pos.do_move(move, st);
-        value = -search<false>(pos, result);
+        value = -search<false>(pos, result, nonBlocking);
         pos.undo_move(move);
 
         if (*result == FAIL)
@@ -1301,7 +1768,7 @@ WDLScore search(Position& pos, ProbeState* result) {
         value = bestValue;
     else
     {
-        value = probe_table<WDL>(pos, result);
+        value = probe_table<WDL>(pos, result, WDLDraw, nonBlocking);
 
         if (*result == FAIL)
             return WDLDraw;
@@ -1319,10 +1786,21 @@ WDLScore search(Position& pos, ProbeState* result) {
 
 // Called at startup and after every change to
 // "SyzygyPath" UCI option to (re)create the various tables. It is not thread
-// safe, nor it needs to be.
-void Tablebases::init(const std::string& paths) {
+// safe, nor it needs to be. Without 'rescan' and with unchanged paths, as on
+// 'ucinewgame', the set of tables is kept and only the mapped files are freed.
+void Tablebases::init(const std::string& paths, bool rescan) {
+
+    Prefetcher.cancel();
+
+    if (!rescan && paths == TBFile::Paths)
+    {
+        TBTables.unmap();
+        BlockCache.clear(TBTables.size() > 0);
+        return;
+    }
 
     TBTables.clear();
+    BlockCache.clear(false);
     MaxCardinality = 0;
     TBFile::Paths  = paths;
 
@@ -1423,64 +1901,185 @@ void Tablebases::init(const std::string& paths) {
             LeadPawnsSize[leadPawnsCnt][f] = idx;
         }
 
-    // Add entries in TB tables if the corresponding ".rtbw" file exists
+    // Collect all the material combinations, then add entries in TB tables
+    // if the corresponding ".rtbw" file exists.
+    std::vector<std::vector<PieceType>> candidates;
     for (PieceType p1 = PAWN; p1 < KING; ++p1)
     {
-        TBTables.add({KING, p1, KING});
+        candidates.push_back({KING, p1, KING});
 
         for (PieceType p2 = PAWN; p2 <= p1; ++p2)
         {
-            TBTables.add({KING, p1, p2, KING});
-            TBTables.add({KING, p1, KING, p2});
+            candidates.push_back({KING, p1, p2, KING});
+            candidates.push_back({KING, p1, KING, p2});
 
             for (PieceType p3 = PAWN; p3 < KING; ++p3)
-                TBTables.add({KING, p1, p2, KING, p3});
+                candidates.push_back({KING, p1, p2, KING, p3});
 
             for (PieceType p3 = PAWN; p3 <= p2; ++p3)
             {
-                TBTables.add({KING, p1, p2, p3, KING});
+                candidates.push_back({KING, p1, p2, p3, KING});
 
                 for (PieceType p4 = PAWN; p4 <= p3; ++p4)
                 {
-                    TBTables.add({KING, p1, p2, p3, p4, KING});
+                    candidates.push_back({KING, p1, p2, p3, p4, KING});
 
                     for (PieceType p5 = PAWN; p5 <= p4; ++p5)
-                        TBTables.add({KING, p1, p2, p3, p4, p5, KING});
+                        candidates.push_back({KING, p1, p2, p3, p4, p5, KING});
 
                     for (PieceType p5 = PAWN; p5 < KING; ++p5)
-                        TBTables.add({KING, p1, p2, p3, p4, KING, p5});
+                        candidates.push_back({KING, p1, p2, p3, p4, KING, p5});
                 }
 
                 for (PieceType p4 = PAWN; p4 < KING; ++p4)
                 {
-                    TBTables.add({KING, p1, p2, p3, KING, p4});
+                    candidates.push_back({KING, p1, p2, p3, KING, p4});
 
                     for (PieceType p5 = PAWN; p5 <= p4; ++p5)
-                        TBTables.add({KING, p1, p2, p3, KING, p4, p5});
+                        candidates.push_back({KING, p1, p2, p3, KING, p4, p5});
                 }
             }
 
             for (PieceType p3 = PAWN; p3 <= p1; ++p3)
                 for (PieceType p4 = PAWN; p4 <= (p1 == p3 ? p2 : p3); ++p4)
-                    TBTables.add({KING, p1, p2, KING, p3, p4});
+                    candidates.push_back({KING, p1, p2, KING, p3, p4});
         }
     }
 
+    // Look for the files in parallel: on network storage each lookup is a round
+    // trip and there are more than a thousand candidates with 7-piece tables.
+    constexpr size_t         ScanThreads = 16;
+    std::vector<std::string> codes(candidates.size());
+    std::vector<char>        found(candidates.size());
+    std::vector<std::thread> threads;
+
+    for (size_t i = 0; i < candidates.size(); ++i)
+    {
+        for (PieceType pt : candidates[i])
+            codes[i] += PieceToChar[pt];
+
+        codes[i].insert(codes[i].find('K', 1), "v");  // KRK -> KRvK
+    }
+
+    for (size_t t = 0; t < ScanThreads; ++t)
+        threads.emplace_back([&, t]() {
+            for (size_t i = t; i < codes.size(); i += ScanThreads)
+                found[i] = TBFile(codes[i] + ".rtbw").is_open();  // Only WDL file is checked
+        });
+
+    for (std::thread& th : threads)
+        th.join();
+
+    // Add tables in the candidates order, so that the result doesn't depend on timing
+    for (size_t i = 0; i < candidates.size(); ++i)
+        if (found[i])
+            TBTables.add(codes[i], int(candidates[i].size()));
+
+    BlockCache.clear(TBTables.size() > 0);
+
     sync_cout << "info string Found " << TBTables.size() << " tablebases" << sync_endl;
 }
 
+// Called at startup and after every change to "SyzygyMapPolicy" UCI option.
+// The policy applies to the files mapped from now on.
+void Tablebases::set_map_policy(MapPolicy policy) { TBFile::Policy = policy; }
+
+// Queues for background mapping and read-ahead the WDL tables that the search
+// from the given root may reach in a few captures. Promotions are not taken
+// into account. Tables with more pieces than 'cardinality' are never probed.
+void Tablebases::prefetch(const Position& pos, int cardinality) {
+
+    int pieceCount = popcount(pos.pieces());
+
+    if (pieceCount - PrefetchCaptures > cardinality)
+        return;
+
+    TBTables.for_each<WDL>([&](TBTable<WDL>& e) {
+        if (e.pieceCount <= cardinality && e.pieceCount >= pieceCount - PrefetchCaptures
+            && !e.ready.load(std::memory_order_relaxed) && reachable(e.code, pos))
+            Prefetcher.push(&e);
+    });
+}
+
+// Returns a report of the probes done since the last reset, one line per probed
+// table with WDL and DTZ probes, their average latency and the number of slow
+// probes, that likely waited for the disk. With 'reset' the counters restart.
+std::string Tablebases::stats(bool reset) {
+
+    std::stringstream ss;
+    uint64_t          total = 0;
+
+    if (!ProbeStats::Enabled)
+    {
+        auto [hits, misses] = BlockCache.stats(reset);
+
+        ss << "Tablebase probe statistics not collected, build with 'make tbstats=yes'"
+           << "\nBlock cache hits: " << hits << ", misses: " << misses;
+        return ss.str();
+    }
+
+    auto print = [&](ProbeStats& st) {
+        uint64_t n = st.probes;
+        ss << std::setw(11) << n << std::setw(10)
+           << (n ? double(st.nanoseconds) / n / 1000 : 0.0) << std::setw(8) << st.slow;
+        total += n;
+
+        if (reset)
+            st.clear();
+    };
+
+    ss << std::fixed << std::setprecision(2) << std::left << std::setw(10) << "Table"
+       << std::right << std::setw(11) << "WDL probes" << std::setw(10) << "avg us"
+       << std::setw(8) << "slow" << std::setw(11) << "DTZ probes" << std::setw(10) << "avg us"
+       << std::setw(8) << "slow" << std::setw(10) << "deferred\n";
+
+    TBTables.for_each<WDL>([&](TBTable<WDL>& e) {
+        TBTable<DTZ>* dtz = TBTables.get<DTZ>(e.key);
+
+        if (!e.stats.probes && !dtz->stats.probes)
+            return;
+
+        uint64_t deferred = e.stats.deferred;
+
+        ss << std::left << std::setw(10) << e.code << std::right;
+        print(e.stats);
+        print(dtz->stats);
+        ss << std::setw(9) << deferred << "\n";
+    });
+
+    auto [hits, misses] = BlockCache.stats(reset);
+    uint64_t rankings   = RootRanking.probes;
+
+    ss << "Total probes: " << total << "\nBlock cache hits: " << hits << ", misses: " << misses
+       << "\nRoot rankings: " << rankings << ", avg ms: "
+       << (rankings ? double(RootRanking.nanoseconds) / rankings / 1000000 : 0.0)
+       << ", failed: " << RootRanking.deferred;
+
+    if (reset)
+        RootRanking.clear();
+
+    return ss.str();
+}
+
+// Called at startup and after every change to "SyzygyBlockCache" UCI option
+// to set the size in MB of the cache of decompressed blocks. Not thread safe.
+void Tablebases::resize_block_cache(size_t mbSize) {
+    BlockCache.resize(mbSize, TBTables.size() > 0);
+}
+
 // Probe the WDL table for a particular position.
-// If *result != FAIL, the probe was successful.
+// If *result != FAIL, the probe was successful. In non-blocking mode the probe
+// also fails, instead of waiting, when the needed data is not yet in memory.
 // The return value is from the point of view of the side to move:
 // -2 : loss
 // -1 : loss, but draw under 50-move rule
 //  0 : draw
 //  1 : win, but draw under 50-move rule
 //  2 : win
-WDLScore Tablebases::probe_wdl(Position& pos, ProbeState* result) {
+WDLScore Tablebases::probe_wdl(Position& pos, ProbeState* result, bool nonBlocking) {
 
     *result = OK;
-    return search<false>(pos, result);
+    return search<false>(pos, result, nonBlocking);
 }
 
 // Probe the DTZ table for a particular position.
@@ -1571,13 +2170,55 @@ int Tablebases::probe_dtz(Position& pos, ProbeState* result) {
 }
 
 
+namespace {
+
+// Calls probe(p, m) for each root move m, where p is a private copy of the root
+// position. With a thread pool the moves are spread over its threads, which are
+// idle at this point, so that cold tables are paged in concurrently. Returns
+// false if any of the probes failed.
+template<typename Probe>
+bool probe_root_moves(const Position&    pos,
+                      Search::RootMoves& rootMoves,
+                      ThreadPool*        threads,
+                      Probe              probe) {
+
+    std::atomic<size_t> next = 0;
+    std::atomic_bool    ok   = true;
+
+    auto job = [&]() {
+        Position  p;
+        StateInfo st;
+        p.set(pos, &st);
+
+        for (size_t i = next++; ok && i < rootMoves.size(); i = next++)
+            if (!probe(p, rootMoves[i]))
+                ok = false;
+    };
+
+    if (!threads || threads->size() < 2 || rootMoves.size() < 2)
+        job();
+    else
+    {
+        for (Thread* th : *threads)
+            th->run_custom_job(job);
+
+        for (Thread* th : *threads)
+            th->wait_for_search_finished();
+    }
+
+    return ok;
+}
+
+}  // namespace
+
+
 // Use the DTZ tables to rank root moves.
 //
 // A return value false indicates that not all probes were successful.
-bool Tablebases::root_probe(Position& pos, Search::RootMoves& rootMoves, bool rule50) {
-
-    ProbeState result = OK;
-    StateInfo  st;
+bool Tablebases::root_probe(Position&          pos,
+                            Search::RootMoves& rootMoves,
+                            bool               rule50,
+                            ThreadPool*        threads) {
 
     // Obtain 50-move counter for the root position
     int cnt50 = pos.rule50_count();
@@ -1585,21 +2226,24 @@ bool Tablebases::root_probe(Position& pos, Search::RootMoves& rootMoves, bool ru
     // Check whether a position was repeated since the last zeroing move.
     bool rep = pos.has_repeated();
 
-    int dtz, bound = rule50 ? (MAX_DTZ - 100) : 1;
+    int bound = rule50 ? (MAX_DTZ - 100) : 1;
 
     // Probe and rank each move
-    for (auto& m : rootMoves)
-    {
-        pos.do_move(m.pv[0], st);
+    return probe_root_moves(pos, rootMoves, threads, [=](Position& p, Search::RootMove& m) {
+        ProbeState result = OK;
+        StateInfo  st;
+        int        dtz;
+
+        p.do_move(m.pv[0], st);
 
         // Calculate dtz for the current move counting from the root position
-        if (pos.rule50_count() == 0)
+        if (p.rule50_count() == 0)
         {
             // In case of a zeroing move, dtz is one of -101/-1/0/1/101
-            WDLScore wdl = -probe_wdl(pos, &result);
+            WDLScore wdl = -probe_wdl(p, &result);
             dtz          = dtz_before_zeroing(wdl);
         }
-        else if (pos.is_draw(1))
+        else if (p.is_draw(1))
         {
             // In case a root move leads to a draw by repetition or 50-move rule,
             // we set dtz to zero. Note: since we are only 1 ply from the root,
@@ -1609,15 +2253,15 @@ bool Tablebases::root_probe(Position& pos, Search::RootMoves& rootMoves, bool ru
         else
         {
             // Otherwise, take dtz for the new position and correct by 1 ply
-            dtz = -probe_dtz(pos, &result);
+            dtz = -probe_dtz(p, &result);
             dtz = dtz > 0 ? dtz + 1 : dtz < 0 ? dtz - 1 : dtz;
         }
 
         // Make sure that a mating move is assigned a dtz value of 1
-        if (pos.checkers() && dtz == 2 && MoveList<LEGAL>(pos).size() == 0)
+        if (p.checkers() && dtz == 2 && MoveList<LEGAL>(p).size() == 0)
             dtz = 1;
 
-        pos.undo_move(m.pv[0]);
+        p.undo_move(m.pv[0]);
 
         if (result == FAIL)
             return false;
@@ -1637,36 +2281,35 @@ bool Tablebases::root_probe(Position& pos, Search::RootMoves& rootMoves, bool ru
                   : r == 0     ? VALUE_DRAW
                   : r > -bound ? Value((std::min(-3, r + (MAX_DTZ - 200)) * int(PawnValue)) / 200)
                                : -VALUE_MATE + MAX_PLY + 1;
-    }
-
-    return true;
+        return true;
+    });
 }
 
-
 // Use the WDL tables to rank root moves.
 // This is a fallback for the case that some or all DTZ tables are missing.
 //
 // A return value false indicates that not all probes were successful.
-bool Tablebases::root_probe_wdl(Position& pos, Search::RootMoves& rootMoves, bool rule50) {
+bool Tablebases::root_probe_wdl(Position&          pos,
+                                Search::RootMoves& rootMoves,
+                                bool               rule50,
+                                ThreadPool*        threads) {
 
     static const int WDL_to_rank[] = {-MAX_DTZ, -MAX_DTZ + 101, 0, MAX_DTZ - 101, MAX_DTZ};
 
-    ProbeState result = OK;
-    StateInfo  st;
-    WDLScore   wdl;
-
-
     // Probe and rank each move
-    for (auto& m : rootMoves)
-    {
-        pos.do_move(m.pv[0], st);
+    return probe_root_moves(pos, rootMoves, threads, [=](Position& p, Search::RootMove& m) {
+        ProbeState result = OK;
+        StateInfo  st;
+        WDLScore   wdl;
+
+        p.do_move(m.pv[0], st);
 
-        if (pos.is_draw(1))
+        if (p.is_draw(1))
             wdl = WDLDraw;
         else
-            wdl = -probe_wdl(pos, &result);
+            wdl = -probe_wdl(p, &result);
 
-        pos.undo_move(m.pv[0]);
+        p.undo_move(m.pv[0]);
 
         if (result == FAIL)
             return false;
@@ -1676,14 +2319,15 @@ bool Tablebases::root_probe_wdl(Position& pos, Search::RootMoves& rootMoves, boo
         if (!rule50)
             wdl = wdl > WDLDraw ? WDLWin : wdl < WDLDraw ? WDLLoss : WDLDraw;
         m.tbScore = WDL_to_value[wdl + 2];
-    }
-
-    return true;
+        return true;
+    });
 }
 
+
 Config Tablebases::rank_root_moves(const OptionsMap&  options,
                                    Position&          pos,
-                                   Search::RootMoves& rootMoves) {
+                                   Search::RootMoves& rootMoves,
+                                   ThreadPool*        threads) {
     Config config;
 
     if (rootMoves.empty())
@@ -1693,6 +2337,7 @@ Config Tablebases::rank_root_moves(const OptionsMap&  options,
     config.useRule50   = bool(options["Syzygy50MoveRule"]);
     config.probeDepth  = int(options["SyzygyProbeDepth"]);
     config.cardinality = int(options["SyzygyProbeLimit"]);
+    config.nonBlocking = bool(options["SyzygyAsyncProbe"]);
 
     bool dtz_available = true;
 
@@ -1704,17 +2349,28 @@ Config Tablebases::rank_root_moves(const OptionsMap&  options,
         config.probeDepth  = 0;
     }
 
+    if (options["SyzygyPrefetch"])
+        prefetch(pos, config.cardinality);
+
     if (config.cardinality >= popcount(pos.pieces()) && !pos.can_castle(ANY_CASTLING))
     {
+        auto start = std::chrono::steady_clock::now();
+
         // Rank moves using DTZ tables
-        config.rootInTB = root_probe(pos, rootMoves, options["Syzygy50MoveRule"]);
+        config.rootInTB = root_probe(pos, rootMoves, options["Syzygy50MoveRule"], threads);
 
         if (!config.rootInTB)
         {
             // DTZ tables are missing; try to rank moves using WDL tables
-            dtz_available   = false;
-            config.rootInTB = root_probe_wdl(pos, rootMoves, options["Syzygy50MoveRule"]);
+            dtz_available = false;
+            config.rootInTB =
+              root_probe_wdl(pos, rootMoves, options["Syzygy50MoveRule"], threads);
         }
+
+        RootRanking.add(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                          std::chrono::steady_clock::now() - start)
+                          .count(),
+                        !config.rootInTB);
     }
 
     if (config.rootInTB)
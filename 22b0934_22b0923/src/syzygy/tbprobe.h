@@ -19,6 +19,7 @@
 #ifndef TBPROBE_H
 #define TBPROBE_H
 
+#include <cstddef>
 #include <string>
 #include <vector>
 
@@ -26,6 +27,7 @@
 namespace Stockfish {
 class Position;
 class OptionsMap;
+class ThreadPool;
 
 using Depth = int;
 
@@ -41,6 +43,7 @@ struct Config {
     int   cardinality = 0;
     bool  rootInTB    = false;
     bool  useRule50   = false;
+    bool  nonBlocking = false;
     Depth probeDepth  = 0;
 };
 
@@ -60,15 +63,36 @@ enum ProbeState {
     ZEROING_BEST_MOVE = 2    // Best move zeroes DTZ (capture or pawn move)
 };
 
+// How the kernel pages in the memory mapped files, see TBFile::map()
+enum MapPolicy {
+    MapAuto,      // Engine default, currently MapRandom
+    MapRandom,    // Pages are read only when touched, without read-ahead
+    MapWillNeed,  // The whole file is read ahead in the background
+    MapPopulate   // The whole file is read at mapping time
+};
+
 extern int MaxCardinality;
 
 
-void     init(const std::string& paths);
-WDLScore probe_wdl(Position& pos, ProbeState* result);
-int      probe_dtz(Position& pos, ProbeState* result);
-bool     root_probe(Position& pos, Search::RootMoves& rootMoves, bool rule50);
-bool     root_probe_wdl(Position& pos, Search::RootMoves& rootMoves, bool rule50);
-Config   rank_root_moves(const OptionsMap& options, Position& pos, Search::RootMoves& rootMoves);
+void        init(const std::string& paths, bool rescan = true);
+void        resize_block_cache(size_t mbSize);
+void        set_map_policy(MapPolicy policy);
+void        prefetch(const Position& pos, int cardinality);
+std::string stats(bool reset);
+WDLScore    probe_wdl(Position& pos, ProbeState* result, bool nonBlocking = false);
+int         probe_dtz(Position& pos, ProbeState* result);
+bool        root_probe(Position&          pos,
+                       Search::RootMoves& rootMoves,
+                       bool               rule50,
+                       ThreadPool*        threads = nullptr);
+bool        root_probe_wdl(Position&          pos,
+                           Search::RootMoves& rootMoves,
+                           bool               rule50,
+                           ThreadPool*        threads = nullptr);
+Config      rank_root_moves(const OptionsMap&  options,
+                            Position&          pos,
+                            Search::RootMoves& rootMoves,
+                            ThreadPool*        threads = nullptr);
 
 }  // namespace Stockfish::Tablebases
 
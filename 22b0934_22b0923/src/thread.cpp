@@ -22,11 +22,13 @@
 #include <cassert>
 #include <deque>
 #include <memory>
+#include <string>
 #include <unordered_map>
 #include <utility>
 
 #include "misc.h"
 #include "movegen.h"
+#include "nnue/network.h"
 #include "search.h"
 #include "syzygy/tbprobe.h"
 #include "timeman.h"
@@ -64,9 +66,23 @@ Thread::~Thread() {
 
 // Wakes up the thread that will start the search
 void Thread::start_searching() {
-    mutex.lock();
-    searching = true;
-    mutex.unlock();   // Unlock before notifying saves a few CPU-cycles
+    run_custom_job([this]() {
+        worker->perf.start();
+        worker->start_searching();
+        worker->perf.stop();
+    });
+}
+
+
+// Wakes up the thread that will run the given function. Waits first for the
+// previous job, if any, to finish.
+void Thread::run_custom_job(std::function<void()> f) {
+    {
+        std::unique_lock<std::mutex> lk(mutex);
+        cv.wait(lk, [&] { return !searching; });
+        jobFunc   = std::move(f);
+        searching = true;
+    }  // Unlock before notifying saves a few CPU-cycles
     cv.notify_one();  // Wake up the thread in idle_loop()
 }
 
@@ -103,9 +119,13 @@ void Thread::idle_loop() {
         if (exit)
             return;
 
+        std::function<void()> job = std::move(jobFunc);
+        jobFunc                   = nullptr;
+
         lk.unlock();
 
-        worker->start_searching();
+        if (job)
+            job();
     }
 }
 
@@ -113,14 +133,47 @@ Search::SearchManager* ThreadPool::main_manager() {
     return static_cast<Search::SearchManager*>(main_thread()->worker.get()->manager.get());
 }
 
-uint64_t ThreadPool::nodes_searched() const { return accumulate(&Search::Worker::nodes); }
-uint64_t ThreadPool::tb_hits() const { return accumulate(&Search::Worker::tbHits); }
+// During a search these lag behind by up to PublishInterval nodes per helper
+// thread. Once the search is finished they are exact.
+uint64_t ThreadPool::nodes_searched() const { return nodes.load(std::memory_order_relaxed); }
+uint64_t ThreadPool::tb_hits() const { return tbHits.load(std::memory_order_relaxed); }
+
+// Sums the search tree statistics of all the threads into a report, optionally
+// clearing them. Must not be called while searching.
+std::string ThreadPool::search_stats(bool reset) {
+
+    Search::SearchStats total;
+
+    for (Thread* th : threads)
+    {
+        total += th->worker->stats;
+
+        if (reset)
+            th->worker->stats.clear();
+    }
+
+    return total.report();
+}
 
 // Creates/destroys threads to match the requested number.
 // Created and launched threads will immediately go to sleep in idle_loop.
 // Upon resizing, threads are recreated to allow for binding if necessary.
 void ThreadPool::set(Search::SharedState sharedState) {
 
+    const size_t requested = sharedState.options["Threads"];
+
+    set(sharedState, requested);
+
+    // Reallocate the hash with the new threadpool size
+    if (requested > 0)
+        sharedState.tt.resize(sharedState.options["Hash"], requested);
+}
+
+
+// Same as above, but with an explicit number of threads and leaving the hash
+// untouched. Used to build the small pools of the 'analyse' command.
+void ThreadPool::set(Search::SharedState sharedState, size_t requested) {
+
     if (threads.size() > 0)  // destroy any existing thread(s)
     {
         main_thread()->wait_for_search_finished();
@@ -129,8 +182,6 @@ void ThreadPool::set(Search::SharedState sharedState) {
             delete threads.back(), threads.pop_back();
     }
 
-    const size_t requested = sharedState.options["Threads"];
-
     if (requested > 0)  // create new thread(s)
     {
         threads.push_back(new Thread(
@@ -144,27 +195,53 @@ void ThreadPool::set(Search::SharedState sharedState) {
         clear();
 
         main_thread()->wait_for_search_finished();
-
-        // Reallocate the hash with the new threadpool size
-        sharedState.tt.resize(sharedState.options["Hash"], requested);
     }
 }
 
 
-// Sets threadPool data to initial values
+// Sets threadPool data to initial values. Each worker clears its own tables on
+// its own thread, so that this runs in parallel and, once the threads are bound,
+// also writes the memory from the node the tables are used on.
 void ThreadPool::clear() {
 
     for (Thread* th : threads)
-        th->worker->clear();
+        th->run_custom_job([th]() { th->worker->clear(); });
+
+    for (Thread* th : threads)
+        th->wait_for_search_finished();
 
     main_manager()->callsCnt                 = 0;
     main_manager()->bestPreviousScore        = VALUE_INFINITE;
     main_manager()->bestPreviousAverageScore = VALUE_INFINITE;
     main_manager()->previousTimeReduction    = 1.0;
     main_manager()->tm.clear();
+
+    lastRootKey = 0;
 }
 
 
+namespace {
+
+// Identifies the root of a search together with everything the rules look at
+// besides the board: the 50-move counter and the earlier positions that can
+// still be repeated. Two searches with the same context key see the same game.
+Key context_key(const Position& pos) {
+
+    const StateInfo* st  = pos.state();
+    Key              key = pos.key() ^ make_key(uint64_t(st->rule50));
+    int              end = std::min(st->rule50, st->pliesFromNull);
+
+    for (int i = 1; i <= end && st->previous; ++i)
+    {
+        st  = st->previous;
+        key = (key ^ st->key) * 0x9E3779B97F4A7C15ULL;
+    }
+
+    return key;
+}
+
+}  // namespace
+
 // Wakes up main thread waiting in idle_loop() and
 // returns immediately. Main thread will wake up other threads and start the search.
 void ThreadPool::start_thinking(const OptionsMap&  options,
@@ -178,15 +255,9 @@ void ThreadPool::start_thinking(const OptionsMap&  options,
     main_manager()->ponder                                 = limits.ponderMode;
 
     increaseDepth = true;
+    nodes = tbHits = 0;
 
-    Search::RootMoves rootMoves;
-
-    for (const auto& m : MoveList<LEGAL>(pos))
-        if (limits.searchmoves.empty()
-            || std::count(limits.searchmoves.begin(), limits.searchmoves.end(), m))
-            rootMoves.emplace_back(m);
-
-    Tablebases::Config tbConfig = Tablebases::rank_root_moves(options, pos, rootMoves);
+    multiPVLines.clear();
 
     // After ownership transfer 'states' becomes empty, so if we stop the search
     // and call 'go' again without setting a new position states.get() == nullptr.
@@ -195,22 +266,66 @@ void ThreadPool::start_thinking(const OptionsMap&  options,
     if (states.get())
         setupStates = std::move(states);  // Ownership transfer, states is now empty
 
-    // We use Position::set() to set root position across threads. But there are
-    // some StateInfo fields (previous, pliesFromNull, capturedPiece) that cannot
-    // be deduced from a fen string, so set() clears them and they are set from
-    // setupStates->back() later. The rootState is per thread, earlier states are shared
-    // since they are read-only.
+    // Build the root snapshot. Its state is then shared by all the threads, and
+    // so are the earlier states, so all of them must be read-only from now on:
+    // computing the root accumulators here guarantees that no thread updates
+    // the chain, and saves each thread from refreshing them.
+    root.pos.set(pos, &root.state);
+    root.rootMoves.clear();
+
+    for (const auto& m : MoveList<LEGAL>(root.pos))
+        if (limits.searchmoves.empty()
+            || std::count(limits.searchmoves.begin(), limits.searchmoves.end(), m))
+            root.rootMoves.emplace_back(m);
+
+    root.tbConfig = Tablebases::rank_root_moves(options, root.pos, root.rootMoves, this);
+
+    main_thread()->worker->networks.big.hint_common_access(root.pos, false);
+    main_thread()->worker->networks.small.hint_common_access(root.pos, false);
+
+    // The root moves obey "searchmoves" already, the threads need no copy of it
+    limits.searchmoves.clear();
+
+    // In analysis continuation mode, a search of the same root as the previous
+    // one, reached with the same 50-move counter and repetition history, and
+    // without time management resumes the iterative deepening of each thread
+    // where it stopped, with its root moves order, scores and averages, instead
+    // of restarting from depth 1.
+    const Key  rootKey = context_key(pos);
+    const bool resume =
+      options["AnalysisContinuation"] && !limits.use_time_management() && lastRootKey == rootKey;
+
+    lastRootKey = rootKey;
+
+    auto sameMove = [](const Search::RootMove& a, const Search::RootMove& b) {
+        return a.pv[0] == b.pv[0];
+    };
+
+    // Each thread copies the mutable parts of the snapshot. The setup runs on
+    // the threads themselves, in parallel.
     for (Thread* th : threads)
-    {
-        th->worker->limits = limits;
-        th->worker->nodes = th->worker->tbHits = th->worker->nmpMinPly =
-          th->worker->bestMoveChanges          = 0;
-        th->worker->rootDepth = th->worker->completedDepth = 0;
-        th->worker->rootMoves                              = rootMoves;
-        th->worker->rootPos.set(pos.fen(), pos.is_chess960(), &th->worker->rootState);
-        th->worker->rootState = setupStates->back();
-        th->worker->tbConfig  = tbConfig;
-    }
+        th->run_custom_job([&, th]() {
+            th->worker->limits = limits;
+            th->worker->nodes = th->worker->tbHits = th->worker->nmpMinPly =
+              th->worker->bestMoveChanges          = 0;
+            th->worker->publishedNodes = th->worker->publishedTbHits = 0;
+
+            if (resume
+                && std::is_permutation(th->worker->rootMoves.begin(), th->worker->rootMoves.end(),
+                                       root.rootMoves.begin(), root.rootMoves.end(), sameMove))
+                th->worker->rootDepth = th->worker->completedDepth;
+            else
+            {
+                th->worker->rootDepth = th->worker->completedDepth = 0;
+                th->worker->rootMoves                              = root.rootMoves;
+            }
+
+            th->worker->rootPos.set(root.pos, root.pos.state());
+            th->worker->tbConfig = root.tbConfig;
+        });
+
+    for (Thread* th : threads)
+        th->wait_for_search_finished();
 
     main_thread()->start_searching();
 }
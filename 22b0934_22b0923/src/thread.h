@@ -23,8 +23,10 @@
 #include <condition_variable>
 #include <cstddef>
 #include <cstdint>
+#include <functional>
 #include <memory>
 #include <mutex>
+#include <string>
 #include <vector>
 
 #include "position.h"
@@ -49,6 +51,7 @@ class Thread {
 
     void   idle_loop();
     void   start_searching();
+    void   run_custom_job(std::function<void()> f);
     void   wait_for_search_finished();
     size_t id() const { return idx; }
 
@@ -60,6 +63,20 @@ class Thread {
     size_t                  idx, nthreads;
     bool                    exit = false, searching = true;  // Set before starting std::thread
     NativeThread            stdThread;
+    std::function<void()>   jobFunc;
+};
+
+
+// RootSnapshot is the root of a search, built once per 'go' by start_thinking():
+// the root position with both networks' accumulators computed in its state,
+// and the legal root moves ranked by the tablebases. The workers share the
+// root state read-only and only copy what they modify, the position object
+// and the root moves.
+struct RootSnapshot {
+    Position           pos;
+    StateInfo          state;
+    Search::RootMoves  rootMoves;
+    Tablebases::Config tbConfig;
 };
 
 
@@ -83,17 +100,30 @@ class ThreadPool {
     void start_thinking(const OptionsMap&, Position&, StateListPtr&, Search::LimitsType);
     void clear();
     void set(Search::SharedState);
+    void set(Search::SharedState, size_t requested);
 
     Search::SearchManager* main_manager();
     Thread*                main_thread() const { return threads.front(); }
     uint64_t               nodes_searched() const;
     uint64_t               tb_hits() const;
+    std::string            search_stats(bool reset);
     Thread*                get_best_thread() const;
     void                   start_searching();
     void                   wait_for_search_finished() const;
 
     std::atomic_bool stop, abortedSearch, increaseDepth;
 
+    // Set when the hash is shared with other pools running at the same time. The
+    // searches then leave the aging of the table to its owner.
+    bool sharedHash = false;
+
+    // Totals of the counters published by the workers, see
+    // Search::Worker::publish_counters(). Each is on a cache line of its own.
+    alignas(64) std::atomic<uint64_t> nodes{0};
+    alignas(64) std::atomic<uint64_t> tbHits{0};
+
+    Search::MultiPVLines multiPVLines;
+
     auto cbegin() const noexcept { return threads.cbegin(); }
     auto begin() noexcept { return threads.begin(); }
     auto end() noexcept { return threads.end(); }
@@ -103,15 +133,9 @@ class ThreadPool {
 
    private:
     StateListPtr         setupStates;
+    RootSnapshot         root;
     std::vector<Thread*> threads;
-
-    uint64_t accumulate(std::atomic<uint64_t> Search::Worker::*member) const {
-
-        uint64_t sum = 0;
-        for (Thread* th : threads)
-            sum += (th->worker.get()->*member).load(std::memory_order_relaxed);
-        return sum;
-    }
+    Key                  lastRootKey = 0;  // Context of the previous search, see start_thinking()
 };
 
 }  // namespace Stockfish
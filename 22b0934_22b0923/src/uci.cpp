@@ -19,20 +19,28 @@
 #include "uci.h"
 
 #include <algorithm>
+#include <array>
+#include <atomic>
 #include <cassert>
 #include <cctype>
 #include <cmath>
 #include <cstdint>
 #include <cstdlib>
 #include <deque>
+#include <fstream>
+#include <iomanip>
 #include <memory>
+#include <numeric>
 #include <optional>
 #include <sstream>
+#include <string_view>
+#include <thread>
 #include <utility>
 #include <vector>
 
 #include "benchmark.h"
 #include "evaluate.h"
+#include "microbench.h"
 #include "movegen.h"
 #include "nnue/network.h"
 #include "nnue/nnue_common.h"
@@ -59,6 +67,10 @@ UCI::UCI(int argc, char** argv) :
     cli(argc, argv) {
 
     options["Debug Log File"] << Option("", [](const Option& o) { start_logger(o); });
+    options["Debug Log Overflow"] << Option("Block var Block var Drop", "Block",
+                                            [](const Option& o) {
+                                                set_logger_overflow(o == "Drop");
+                                            });
 
     options["Threads"] << Option(1, 1, 1024, [this](const Option&) {
         threads.set({options, threads, tt, networks});
@@ -72,6 +84,7 @@ UCI::UCI(int argc, char** argv) :
     options["Clear Hash"] << Option([this](const Option&) { search_clear(); });
     options["Ponder"] << Option(false);
     options["MultiPV"] << Option(1, 1, MAX_MOVES);
+    options["MultiPVSplit"] << Option(false);
     options["Skill Level"] << Option(20, 0, 20);
     options["Move Overhead"] << Option(10, 0, 5000);
     options["nodestime"] << Option(0, 0, 10000);
@@ -79,15 +92,31 @@ UCI::UCI(int argc, char** argv) :
     options["UCI_LimitStrength"] << Option(false);
     options["UCI_Elo"] << Option(1320, 1320, 3190);
     options["UCI_ShowWDL"] << Option(false);
+    options["InfoInterval"] << Option(0, 0, 60000);
+    options["InfoOnChange"] << Option(false);
+    options["AnalysisContinuation"] << Option(false);
     options["SyzygyPath"] << Option("<empty>", [](const Option& o) { Tablebases::init(o); });
     options["SyzygyProbeDepth"] << Option(1, 1, 100);
     options["Syzygy50MoveRule"] << Option(true);
     options["SyzygyProbeLimit"] << Option(7, 0, 7);
+    options["SyzygyBlockCache"] << Option(16, 0, 1024, [](const Option& o) {
+        Tablebases::resize_block_cache(o);
+    });
+    options["SyzygyMapPolicy"] << Option("Auto var Auto var Random var WillNeed var Populate",
+                                         "Auto", [](const Option& o) {
+                                             Tablebases::set_map_policy(
+                                               o == "Random"     ? Tablebases::MapRandom
+                                               : o == "WillNeed" ? Tablebases::MapWillNeed
+                                               : o == "Populate" ? Tablebases::MapPopulate
+                                                                 : Tablebases::MapAuto);
+                                         });
+    options["SyzygyPrefetch"] << Option(true);
+    options["SyzygyAsyncProbe"] << Option(false);
     options["EvalFile"] << Option(EvalFileDefaultNameBig, [this](const Option& o) {
-        networks.big.load(cli.binaryDirectory, o);
+        networks.big.load_async(cli.binaryDirectory, o);
     });
     options["EvalFileSmall"] << Option(EvalFileDefaultNameSmall, [this](const Option& o) {
-        networks.small.load(cli.binaryDirectory, o);
+        networks.small.load_async(cli.binaryDirectory, o);
     });
 
     networks.big.load(cli.binaryDirectory, options["EvalFile"]);
@@ -95,6 +124,8 @@ UCI::UCI(int argc, char** argv) :
 
     threads.set({options, threads, tt, networks});
 
+    Tablebases::resize_block_cache(options["SyzygyBlockCache"]);
+
     search_clear();  // After threads are up
 }
 
@@ -120,6 +151,13 @@ void UCI::loop() {
         token.clear();  // Avoid a stale if getline() returns nothing or a blank line
         is >> std::skipws >> token;
 
+        // Nets loaded in the background are installed before a command that
+        // evaluates positions, never during a search.
+        if (token == "go" || token == "bench" || token == "eval" || token == "evalbatch"
+            || token == "analyse" || token == "scaling" || token == "microbench"
+            || token == "export_net" || token == "CS433")
+            swap_networks(pos);
+
         if (token == "CS433")
             cs433_project(pos, states);
 
@@ -158,8 +196,24 @@ void UCI::loop() {
             sync_cout << pos << sync_endl;
         else if (token == "eval")
             trace_eval(pos);
+        else if (token == "evalbatch")
+            evalbatch();
+        else if (token == "analyse")
+            analyse(is);
+        else if (token == "scaling")
+            scaling(pos, is);
+        else if (token == "microbench")
+        {
+            networks.big.verify(options["EvalFile"]);
+            networks.small.verify(options["EvalFileSmall"]);
+            microbench(pos, is, networks, tt);
+        }
         else if (token == "compiler")
             sync_cout << compiler_info() << sync_endl;
+        else if (token == "tbstats")
+            sync_cout << Tablebases::stats(is >> token && token == "reset") << sync_endl;
+        else if (token == "searchstats")
+            sync_cout << threads.search_stats(is >> token && token == "reset") << sync_endl;
         else if (token == "export_net")
         {
             std::pair<std::optional<std::string>, std::string> files[2];
@@ -206,6 +260,28 @@ Value getVal (Stockfish::Position &pos, const Eval::NNUE::Networks& networks) {
     return v;
 }
 
+namespace {
+
+// Appends a centipawn value in pawns, printed as streaming 0.01 * cp would,
+// without trailing zeros, e.g. "-0.07", "0.5" or "1".
+void append_pawns(std::string& out, Value cp) {
+    if (cp < 0)
+        out += '-';
+
+    UCI::append_number(out, std::abs(cp) / 100);
+
+    if (int frac = std::abs(cp) % 100)
+    {
+        out += '.';
+        out += char('0' + frac / 10);
+
+        if (frac % 10)
+            out += char('0' + frac % 10);
+    }
+}
+
+}  // namespace
+
 std::pair<Move,Value> makeOneMove (Stockfish::Position &pos, Stockfish::StateListPtr &states, Square fromSq,const Eval::NNUE::Networks& networks) { 
     
     Square *t = AvailablePosn(pos);
@@ -479,14 +555,17 @@ void UCI::cs433_project(Stockfish::Position &pos, Stockfish::StateListPtr &state
     */
     Square fromSq [7] = {SQ_A1,SQ_B1,SQ_C1,SQ_D1,SQ_F1,SQ_G1,SQ_H1};
 //    trace_eval(pos);
-    std::cout<<"current evaluation is "<<0.01 * getVal(pos,networks)<<"\n";
+    std::string out;
+    append_pawns(out.assign("current evaluation is "), getVal(pos,networks));
+    sync_cout << out << sync_endl;
     std::pair<Move,std::pair<Move,std::pair<Move,std::pair<Move,Value>>>> finalSet = makeFirstMove(pos,states,fromSq,networks);
     StateInfo *t = new StateInfo[8];
     pos.move433(finalSet.first,t[0]);
     pos.move433(finalSet.second.first,t[1]);
     pos.move433(finalSet.second.second.first,t[2]);
     pos.move433(finalSet.second.second.second.first,t[3]);
-    std::cout<<"Now evaluation is "<<0.01*getVal(pos,networks)<<"\n";
+    append_pawns(out.assign("Now evaluation is "), getVal(pos,networks));
+    sync_cout << out << sync_endl;
     trace_eval(pos);
     //compute relevant board configuration where 4 pieces are relocated, by performing a state space search over the staring board configuration
 
@@ -551,15 +630,94 @@ void UCI::go(Position& pos, std::istringstream& is, StateListPtr& states) {
     threads.start_thinking(options, pos, states, limits);
 }
 
+namespace {
+
+// Prints the hardware counters collected by bench, with the usual derived
+// figures, or a note if the kernel didn't let us open any event.
+void print_perf_counters(const std::array<uint64_t, PerfCounters::EVENT_NB>& counts,
+                         const std::array<bool, PerfCounters::EVENT_NB>&     available,
+                         uint64_t                                            nodes) {
+
+    using PC = PerfCounters;
+
+    if (std::none_of(available.begin(), available.end(), [](bool b) { return b; }))
+    {
+        std::cerr << "\nPerf counters   : not available" << std::endl;
+        return;
+    }
+
+    std::cerr << "\n";
+
+    for (int e = 0; e < PC::EVENT_NB; ++e)
+    {
+        std::string name = PC::name(PC::Event(e));
+
+        std::cerr << name << std::string(16 - name.size(), ' ') << ": ";
+
+        if (!available[e])
+        {
+            std::cerr << "n/a" << std::endl;
+            continue;
+        }
+
+        std::cerr << counts[e] << " (" << counts[e] / std::max(nodes, uint64_t(1)) << "/node";
+
+        if (e == PC::Instructions && available[PC::Cycles] && counts[PC::Cycles])
+            std::cerr << ", IPC " << double(counts[e]) / counts[PC::Cycles];
+
+        else if (e > PC::Instructions && available[PC::Instructions] && counts[PC::Instructions])
+            std::cerr << ", " << 1000.0 * counts[e] / counts[PC::Instructions] << "/kinstr";
+
+        std::cerr << ")" << std::endl;
+    }
+}
+
+}  // namespace
+
 void UCI::bench(Position& pos, std::istream& args, StateListPtr& states) {
     std::string token;
     uint64_t    num, nodes = 0, cnt = 1;
 
     std::vector<std::string> list = setup_bench(pos, args);
 
+    // Optional flags may follow the bench arguments. With "json" the searches are
+    // silent and a report with per-position figures and the run metadata is
+    // written to stdout. The nets are then verified once and quietly, and eval
+    // traces go to stderr, so that the report is all there is on stdout. With
+    // "perf" the hardware performance counters of the search threads are read and
+    // added to the summary. With "fixed" the run is a fixed-work parallel bench
+    // instead, see fixed_bench().
+    bool json = false, perf = false, fixed = false;
+
+    while (args >> token)
+        json |= token == "json", perf |= token == "perf", fixed |= token == "fixed";
+
+    if (fixed)
+    {
+        fixed_bench(list);
+        return;
+    }
+
+    json = json && std::none_of(list.begin(), list.end(), [](const std::string& s) {
+               return s.find("go perft") == 0;
+           });
+
+    std::string                                  report;
+    std::array<uint64_t, PerfCounters::EVENT_NB> counts    = {};
+    std::array<bool, PerfCounters::EVENT_NB>     available = {};
+
+    if (json)
+    {
+        networks.big.verify(options["EvalFile"], true);
+        networks.small.verify(options["EvalFileSmall"], true);
+    }
+
     num = count_if(list.begin(), list.end(),
                    [](const std::string& s) { return s.find("go ") == 0 || s.find("eval") == 0; });
 
+    Tablebases::stats(true);     // Reset the probe counters
+    threads.search_stats(true);  // and the search tree statistics
+
     TimePoint elapsed = now();
 
     for (const auto& cmd : list)
@@ -573,9 +731,54 @@ void UCI::bench(Position& pos, std::istream& args, StateListPtr& states) {
                       << std::endl;
             if (token == "go")
             {
-                go(pos, is, states);
+                TimePoint time = now();
+
+                threads.main_manager()->silent = json;
+
+                for (Thread* th : threads)
+                    th->worker->perf.enabled = perf;
+
+                if (json)
+                    threads.start_thinking(options, pos, states, parse_limits(pos, is));
+                else
+                    go(pos, is, states);
+
                 threads.main_thread()->wait_for_search_finished();
+                threads.main_manager()->silent = false;
                 nodes += threads.nodes_searched();
+
+                for (Thread* th : threads)
+                    for (int e = 0; e < PerfCounters::EVENT_NB; ++e)
+                    {
+                        counts[e] += th->worker->perf.counts[e];
+                        available[e] |= th->worker->perf.available(PerfCounters::Event(e));
+                        th->worker->perf.clear();
+                    }
+
+                if (json)
+                {
+                    const Search::SearchResult& r = threads.main_manager()->result;
+
+                    time = now() - time + 1;
+
+                    report += std::string(report.empty() ? "" : ",\n") + "    {\"fen\": \""
+                            + pos.fen() + "\", \"nodes\": " + std::to_string(r.nodes)
+                            + ", \"time\": " + std::to_string(time)
+                            + ", \"nps\": " + std::to_string(1000 * r.nodes / time)
+                            + ", \"depth\": " + std::to_string(r.depth)
+                            + ", \"seldepth\": " + std::to_string(r.selDepth)
+                            + ", \"hashfull\": " + std::to_string(tt.hashfull())
+                            + ", \"tbhits\": " + std::to_string(threads.tb_hits())
+                            + ", \"bestmove\": \""
+                            + move(r.pv[0], options["UCI_Chess960"]) + "\"}";
+                }
+            }
+            else if (json)
+            {
+                StateInfo st;
+                Position  p;
+                p.set(pos.fen(), options["UCI_Chess960"], &st);
+                std::cerr << "\n" << Eval::trace(p, networks) << std::endl;
             }
             else
                 trace_eval(pos);
@@ -593,11 +796,197 @@ void UCI::bench(Position& pos, std::istream& args, StateListPtr& states) {
 
     elapsed = now() - elapsed + 1;  // Ensure positivity to avoid a 'divide by zero'
 
+    // Later searches must not pay for reading the counters
+    for (Thread* th : threads)
+        th->worker->perf.enabled = false;
+
     dbg_print();
 
     std::cerr << "\n==========================="
               << "\nTotal time (ms) : " << elapsed << "\nNodes searched  : " << nodes
               << "\nNodes/second    : " << 1000 * nodes / elapsed << std::endl;
+
+    if (Tablebases::MaxCardinality)
+        std::cerr << "\n" << Tablebases::stats(false) << std::endl;
+
+    if (Search::SearchStats::Enabled)
+        std::cerr << "\n" << threads.search_stats(false) << std::endl;
+
+    if (perf)
+        print_perf_counters(counts, available, nodes);
+
+    if (json)
+    {
+        std::string engine = engine_info(), compiler;
+
+        for (char c : compiler_info())
+            if (c != '\n')
+                compiler += c;
+            else if (!compiler.empty())
+                compiler += "; ";
+
+        compiler.erase(compiler.find_last_not_of("; ") + 1);
+
+#if defined(ARCH)
+        const std::string arch = stringify(ARCH);
+#else
+        const std::string arch = "undefined";
+#endif
+
+        sync_cout << "{\n  \"engine\": \"" << engine.substr(0, engine.find(" by ")) << "\",\n"
+                  << "  \"compiler\": \"" << compiler << "\",\n"
+                  << "  \"arch\": \"" << arch << "\",\n"
+                  << "  \"threads\": " << int(options["Threads"]) << ",\n"
+                  << "  \"hash\": " << int(options["Hash"]) << ",\n"
+                  << "  \"positions\": [\n"
+                  << report << "\n  ],\n"
+                  << "  \"total\": {\"nodes\": " << nodes << ", \"time\": " << elapsed
+                  << ", \"nps\": " << 1000 * nodes / elapsed;
+
+        if (perf)
+            for (int e = 0; e < PerfCounters::EVENT_NB; ++e)
+                if (available[e])
+                    std::cout << ", \"" << PerfCounters::name(PerfCounters::Event(e))
+                              << "\": " << counts[e];
+
+        std::cout << "}\n}" << sync_endl;
+    }
+}
+
+// Runs the searches of a bench list as fixed work per thread. Every thread gets a
+// one-thread pool with a private hash of the bench Hash size, and searches all the
+// positions on its own, so that no thread ever stops or waits for another one.
+// Each thread then does exactly the work of a single-threaded bench and must
+// reproduce its node count, whatever the scheduling, and the aggregate nodes per
+// second can be compared across builds even on a busy multi-core machine. The
+// options set by the list, other than Threads and Hash, are applied up front.
+void UCI::fixed_bench(const std::vector<std::string>& list) {
+
+    std::vector<std::pair<std::string, std::string>> searches;  // position and go commands
+    std::string                                      token, lastPosition;
+    size_t                                           threadCount = 1, hashMB = 16;
+
+    for (const auto& cmd : list)
+    {
+        std::istringstream is(cmd);
+        is >> std::skipws >> token;
+
+        if (token == "setoption")
+        {
+            std::string name, value;
+            std::istringstream(cmd) >> token >> token >> name >> token >> value;
+
+            if (name == "Threads")
+                threadCount = size_t(std::max(std::atoi(value.c_str()), 1));
+            else if (name == "Hash")
+                hashMB = size_t(std::max(std::atoi(value.c_str()), 1));
+            else
+                setoption(is);
+        }
+        else if (token == "position")
+            lastPosition = cmd;
+        else if (token == "go" && !lastPosition.empty())
+            searches.emplace_back(lastPosition, cmd);
+    }
+
+    std::vector<uint64_t>  nodes(threadCount);
+    std::vector<TimePoint> times(threadCount);
+
+    TimePoint elapsed = run_pools(threadCount, 1, hashMB, false, [&](size_t i, ThreadPool& pool) {
+        TimePoint start = now();
+
+        for (const auto& [positionCmd, goCmd] : searches)
+        {
+            StateListPtr       states;
+            Position           p;
+            std::istringstream ps(positionCmd), gs(goCmd);
+            std::string        cmd;
+
+            ps >> cmd, gs >> cmd;  // Skip "position" and "go"
+            position(p, ps, states);
+
+            pool.start_thinking(options, p, states, parse_limits(p, gs));
+            pool.main_thread()->wait_for_search_finished();
+
+            nodes[i] += pool.main_manager()->result.nodes;
+        }
+
+        times[i] = now() - start + 1;
+    });
+
+    const uint64_t total = std::accumulate(nodes.begin(), nodes.end(), uint64_t(0));
+    const bool     same  = std::all_of(nodes.begin(), nodes.end(),
+                                       [&](uint64_t n) { return n == nodes.front(); });
+
+    std::cerr << "\n==========================="
+              << "\nFixed work      : " << threadCount << " threads x " << searches.size()
+              << " searches, " << hashMB << " MB hash each";
+
+    for (size_t i = 0; i < threadCount; ++i)
+    {
+        std::string label = "Thread " + std::to_string(i + 1);
+
+        std::cerr << "\n" << label << std::string(16 - label.size(), ' ') << ": " << nodes[i]
+                  << " nodes, " << times[i] << " ms, " << 1000 * nodes[i] / times[i] << " nps";
+    }
+
+    std::cerr << "\nSignature       : " << nodes.front()
+              << (same ? " (identical on all threads)" : " (DIFFERS between threads)")
+              << "\nTotal time (ms) : " << elapsed << "\nNodes searched  : " << total
+              << "\nNodes/second    : " << 1000 * total / elapsed << std::endl;
+}
+
+// Runs job(i, pool) for each i < count on a driver thread of its own, with a
+// private ThreadPool of poolSize threads whose main thread is silent. Each pool
+// gets a private hash of hashMB, or with sharedHash they all use the main one.
+// Returns the time the jobs took, once the pools are set up.
+TimePoint UCI::run_pools(size_t                                          count,
+                         size_t                                          poolSize,
+                         size_t                                          hashMB,
+                         bool                                            sharedHash,
+                         const std::function<void(size_t, ThreadPool&)>& job) {
+
+    threads.main_thread()->wait_for_search_finished();
+
+    networks.big.verify(options["EvalFile"]);
+    networks.small.verify(options["EvalFileSmall"]);
+
+    // Deques, because neither ThreadPool nor TranspositionTable can be moved
+    std::deque<TranspositionTable> hashes(sharedHash ? 0 : count);
+    std::deque<ThreadPool>         pools(count);
+    std::vector<std::thread>       drivers;
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        TranspositionTable& poolTT = sharedHash ? tt : hashes[i];
+
+        pools[i].set({options, pools[i], poolTT, networks}, poolSize);
+        pools[i].main_manager()->silent = true;
+        pools[i].sharedHash             = sharedHash;
+
+        if (!sharedHash)
+            poolTT.resize(hashMB, poolSize);
+    }
+
+    // A shared hash is aged once here for the whole run. Aging it at the start of
+    // each search would race with the probes of the other pools, and make the
+    // concurrent searches push each other's entries out.
+    if (sharedHash)
+        tt.new_search();
+
+    TimePoint elapsed = now();
+
+    for (size_t i = 0; i < count; ++i)
+        drivers.emplace_back([&, i]() { job(i, pools[i]); });
+
+    for (std::thread& th : drivers)
+        th.join();
+
+    elapsed = now() - elapsed + 1;
+
+    dbg_print();  // The silent pools leave it to us
+
+    return elapsed;
 }
 
 void UCI::trace_eval(Position& pos) {
@@ -612,12 +1001,476 @@ void UCI::trace_eval(Position& pos) {
     sync_cout << "\n" << Eval::trace(p, networks) << sync_endl;
 }
 
+namespace {
+
+// Returns s with the characters that cannot appear as such in a JSON string
+// escaped, like quotes in a malformed EPD line.
+std::string json_escape(const std::string& s) {
+
+    constexpr char Hex[] = "0123456789abcdef";
+    std::string    out;
+
+    for (char c : s)
+        if (c == '"' || c == '\\')
+            out += '\\', out += c;
+        else if (static_cast<unsigned char>(c) < 0x20)
+            out += "\\u00", out += Hex[c >> 4], out += Hex[c & 15];
+        else
+            out += c;
+
+    return out;
+}
+
+// Position::set() is not robust against malformed input, so check that the
+// piece placement describes 8x8 squares, with one king per side, that the side
+// to move is given, that each castling right has its king and rook on the back
+// rank, and that an en passant square is behind a pawn that has just moved.
+bool valid_fen(const std::string& fen) {
+
+    std::istringstream ss(fen);
+    std::string        board, side, castling = "-", ep = "-";
+    char               squares[8][8] = {};  // Indexed by [7 - rank][file]
+    int                rank = 0, file = 0, kings[2] = {};
+
+    ss >> board >> side >> castling >> ep;
+
+    for (char c : board)
+        if (c == '/')
+        {
+            if (file != 8 || ++rank > 7)
+                return false;
+            file = 0;
+        }
+        else if (c >= '1' && c <= '8')
+            file += c - '0';
+        else if (std::string_view("pnbrqkPNBRQK").find(c) != std::string_view::npos)
+        {
+            if (file > 7)
+                return false;
+            kings[0] += c == 'K', kings[1] += c == 'k';
+            squares[rank][file++] = c;
+        }
+        else
+            return false;
+
+    if (rank != 7 || file != 8 || kings[0] != 1 || kings[1] != 1 || (side != "w" && side != "b"))
+        return false;
+
+    if (castling != "-")
+        for (char c : castling)
+        {
+            bool        white = isupper(c);
+            const char* back  = squares[white ? 7 : 0];
+            char        rook  = white ? 'R' : 'r';
+            int         king  = int(std::find(back, back + 8, white ? 'K' : 'k') - back);
+            char        token = char(toupper(c));
+
+            bool found = token == 'K' ? std::find(back + king, back + 8, rook) != back + 8
+                       : token == 'Q' ? std::find(back, back + king, rook) != back + king
+                                      : token >= 'A' && token <= 'H' && back[token - 'A'] == rook;
+
+            if (king == 8 || !found)
+                return false;
+        }
+
+    if (ep != "-")
+    {
+        bool white = side == "w";
+
+        if (ep.size() != 2 || ep[0] < 'a' || ep[0] > 'h' || ep[1] != (white ? '6' : '3'))
+            return false;
+
+        int epRank = '8' - ep[1], epFile = ep[0] - 'a';
+
+        if (squares[epRank][epFile]
+            || squares[white ? epRank + 1 : epRank - 1][epFile] != (white ? 'p' : 'P'))
+            return false;
+    }
+
+    return true;
+}
+
+}  // namespace
+
+// Reads FENs from stdin, one per line, until EOF or a line with "end", and writes
+// one line per position: "<id> <big> <small> <eval>". These are the raw scores of
+// the big and the small nets and the final evaluation, in internal units and from
+// the point of view of the side to move. The final evaluation is "none" when in
+// check, and the scores are "invalid" for a malformed FEN. Positions are
+// evaluated in batches by the search threads, the output follows the input order.
+void UCI::evalbatch() {
+
+    constexpr size_t BatchSize = 8192;
+
+    threads.main_thread()->wait_for_search_finished();
+
+    networks.big.verify(options["EvalFile"]);
+    networks.small.verify(options["EvalFileSmall"]);
+
+    const size_t threadCount = threads.size();
+    const bool   chess960    = options["UCI_Chess960"];
+
+    std::vector<std::string> fens, results;
+    std::string              line, out;
+    uint64_t                 id  = 0;
+    bool                     eof = false;
+
+    while (!eof)
+    {
+        fens.clear();
+
+        while (fens.size() < BatchSize)
+            if (!std::getline(std::cin, line) || line == "end")
+            {
+                eof = true;
+                break;
+            }
+            else if (!line.empty())
+                fens.push_back(line);
+
+        results.assign(fens.size(), std::string());
+
+        // The batch is evaluated by the idle search threads, which stay alive
+        // from one batch to the next.
+        for (Thread* th : threads)
+            th->run_custom_job([&, t = th->id()]() {
+                StateInfo st;
+                Position  p;
+
+                for (size_t i = t; i < fens.size(); i += threadCount)
+                {
+                    if (!valid_fen(fens[i]))
+                    {
+                        results[i] = "invalid";
+                        continue;
+                    }
+
+                    p.set(fens[i], chess960, &st);
+
+                    Value v = p.checkers() ? VALUE_NONE : Eval::evaluate(networks, p, VALUE_ZERO);
+
+                    results[i] = std::to_string(networks.big.evaluate(p)) + ' '
+                               + std::to_string(networks.small.evaluate(p)) + ' '
+                               + (v == VALUE_NONE ? "none" : std::to_string(v));
+                }
+            });
+
+        for (Thread* th : threads)
+            th->wait_for_search_finished();
+
+        out.clear();
+
+        for (const std::string& r : results)
+            out += std::to_string(++id) + ' ' + r + '\n';
+
+        sync_cout << out << std::flush << IO_UNLOCK;
+    }
+}
+
+// Searches all the positions of an EPD file and streams one JSON line per
+// position as soon as it is done. The "Threads" threads are split into groups
+// of 'groupsize' threads, each group searching its own position with its own
+// slice of "Hash", or with the main hash table if 'sharedhash' is given.
+// Usage: analyse <file> [groupsize N] [sharedhash] [depth N | nodes N | movetime N]
+void UCI::analyse(std::istringstream& is) {
+
+    Search::LimitsType limits;
+    std::string        file, token, line;
+    size_t             groupSize  = 1;
+    bool               sharedHash = false;
+
+    is >> file;
+
+    while (is >> token)
+        if (token == "groupsize")
+            is >> groupSize;
+        else if (token == "sharedhash")
+            sharedHash = true;
+        else if (token == "depth")
+            is >> limits.depth;
+        else if (token == "nodes")
+            is >> limits.nodes;
+        else if (token == "movetime")
+            is >> limits.movetime;
+
+    if (!limits.depth && !limits.nodes && !limits.movetime)
+        limits.depth = 13;
+
+    std::ifstream            in(file);
+    std::vector<std::string> fens;
+
+    if (!in.is_open())
+    {
+        sync_cout << "info string Unable to open file " << file << sync_endl;
+        return;
+    }
+
+    // Keep the piece placement, side, castling and ep square of each EPD record,
+    // and the move counters if there are any.
+    while (std::getline(in, line))
+    {
+        std::istringstream ss(line);
+        std::string        fen, field;
+
+        for (int i = 0; i < 6 && ss >> field; ++i)
+            if (i < 4 || std::all_of(field.begin(), field.end(), ::isdigit))
+                fen += (i ? " " : "") + field;
+            else
+                break;
+
+        if (!fen.empty())
+            fens.push_back(fen);
+    }
+
+    const size_t threadCount = size_t(options["Threads"]);
+    const bool   chess960    = options["UCI_Chess960"];
+
+    groupSize = std::clamp(groupSize, size_t(1), threadCount);
+
+    const size_t groupCount = std::min(threadCount / groupSize, std::max(fens.size(), size_t(1)));
+    const size_t hashMB     = std::max(size_t(options["Hash"]) / groupCount, size_t(1));
+
+    std::atomic<size_t>   next  = 0;
+    std::atomic<uint64_t> nodes = 0;
+
+    auto job = [&](size_t, ThreadPool& pool) {
+        for (size_t i = next++; i < fens.size(); i = next++)
+        {
+            if (!valid_fen(fens[i]))
+            {
+                sync_cout << "{\"id\":" << i + 1 << ",\"fen\":\"" << json_escape(fens[i])
+                          << "\",\"error\":\"invalid fen\"}" << sync_endl;
+                continue;
+            }
+
+            StateListPtr states(new std::deque<StateInfo>(1));
+            Position     p;
+            p.set(fens[i], chess960, &states->back());
+
+            Search::LimitsType l = limits;
+            l.startTime          = now();
+
+            pool.start_thinking(options, p, states, l);
+            pool.main_thread()->wait_for_search_finished();
+
+            const Search::SearchResult& r = pool.main_manager()->result;
+            std::string                 unit, score, pv;
+
+            std::istringstream(to_score(r.score, p)) >> unit >> score;
+
+            for (Move m : r.pv)
+                if (m != Move::none())
+                    pv += std::string(pv.empty() ? "\"" : ",\"") + move(m, chess960) + '"';
+
+            nodes += r.nodes;
+
+            sync_cout << "{\"id\":" << i + 1 << ",\"fen\":\"" << json_escape(fens[i])
+                      << "\",\"bestmove\":\"" << move(r.pv[0], chess960) << "\",\"score\":{\""
+                      << unit << "\":" << score << "},\"depth\":" << r.depth
+                      << ",\"seldepth\":" << r.selDepth << ",\"nodes\":" << r.nodes
+                      << ",\"time\":" << r.time << ",\"pv\":[" << pv << "]}" << sync_endl;
+        }
+    };
+
+    TimePoint elapsed = run_pools(groupCount, groupSize, hashMB, sharedHash, job);
+
+    std::cerr << "\n==========================="
+              << "\nPositions       : " << fens.size() << "\nThread groups   : " << groupCount
+              << " x " << groupSize << "\nTotal time (ms) : " << elapsed
+              << "\nNodes searched  : " << nodes
+              << "\nNodes/second    : " << 1000 * nodes / elapsed << std::endl;
+}
+
+// Measures how the search scales with the number of threads: the bench searches
+// are run to a fixed depth at each thread count of the list, with a fixed hash
+// size per thread. For each count we report the nodes per second and the time
+// to depth, that is the time the searches took, with the speedups of both and
+// the nps efficiency over the first count of the list. With several hash sizes
+// the whole list is run for each. A table goes to stderr, a JSON report to stdout.
+// Usage: scaling [threads 1,2,4,...] [hash 16,...] [depth 13] [fens default|current|<file>]
+void UCI::scaling(Position& pos, std::istringstream& is) {
+
+    auto parse_list = [](const std::string& str) {
+        std::vector<size_t> values;
+        std::istringstream  ss(str);
+        std::string         item;
+
+        while (std::getline(ss, item, ','))
+            if (std::atoi(item.c_str()) > 0)
+                values.push_back(size_t(std::atoi(item.c_str())));
+
+        return values;
+    };
+
+    std::vector<size_t> threadCounts, hashSizes;
+    std::string         token, fens = "default";
+    int                 depth = 13;
+
+    while (is >> token)
+        if (token == "threads" && is >> token)
+            threadCounts = parse_list(token);
+        else if (token == "hash" && is >> token)
+            hashSizes = parse_list(token);
+        else if (token == "depth")
+            is >> depth;
+        else if (token == "fens")
+            is >> fens;
+
+    const size_t hardwareThreads = std::max(std::thread::hardware_concurrency(), 1u);
+
+    // By default the powers of two up to the number of hardware threads, and that
+    if (threadCounts.empty())
+    {
+        for (size_t t = 1; t < hardwareThreads; t *= 2)
+            threadCounts.push_back(t);
+
+        threadCounts.push_back(hardwareThreads);
+    }
+
+    if (hashSizes.empty())
+        hashSizes.push_back(16);
+
+    std::istringstream             args("16 1 " + std::to_string(std::max(depth, 1)) + " " + fens
+                                            + " depth");
+    const std::vector<std::string> list = setup_bench(pos, args);
+
+    threads.main_thread()->wait_for_search_finished();
+
+    networks.big.verify(options["EvalFile"]);
+    networks.small.verify(options["EvalFileSmall"]);
+
+    struct Run {
+        size_t    hash, threads;
+        uint64_t  nodes;
+        TimePoint time;
+    };
+
+    const std::string  oldThreads = std::to_string(int(options["Threads"]));
+    const std::string  oldHash    = std::to_string(int(options["Hash"]));
+    std::vector<Run>   runs;
+    size_t             positions = 0;
+    std::ostringstream table, json;
+
+    auto set = [&](const std::string& name, const std::string& value) {
+        std::istringstream ss("name " + name + " value " + value);
+        setoption(ss);
+    };
+
+    for (size_t hash : hashSizes)
+        for (size_t threadCount : threadCounts)
+        {
+            Run          run{hash, threadCount, 0, 0};
+            Position     p;
+            StateListPtr states;
+
+            set("Threads", std::to_string(threadCount));
+            set("Hash", std::to_string(hash * threadCount));
+            positions = 0;
+
+            // The Threads and Hash lines of the bench list are ours to set
+            for (const auto& cmd : list)
+            {
+                std::istringstream cs(cmd);
+                cs >> std::skipws >> token;
+
+                if (token == "setoption" && cmd.find(" Threads ") == std::string::npos
+                    && cmd.find(" Hash ") == std::string::npos)
+                    setoption(cs);
+                else if (token == "ucinewgame")
+                    search_clear();
+                else if (token == "position")
+                    position(p, cs, states);
+                else if (token == "go")
+                {
+                    TimePoint start = now();
+
+                    threads.main_manager()->silent = true;
+                    threads.start_thinking(options, p, states, parse_limits(p, cs));
+                    threads.main_thread()->wait_for_search_finished();
+                    threads.main_manager()->silent = false;
+
+                    run.time += now() - start;
+                    run.nodes += threads.nodes_searched();
+                    ++positions;
+                }
+            }
+
+            run.time = std::max(run.time, TimePoint(1));
+            runs.push_back(run);
+
+            std::cerr << "Hash " << hash << " MB x " << threadCount << " threads: " << run.nodes
+                      << " nodes in " << run.time << " ms" << std::endl;
+        }
+
+    set("Threads", oldThreads);
+    set("Hash", oldHash);
+
+    table << std::fixed << std::setprecision(2) << "\n" << std::setw(9) << "Hash/thr"
+          << std::setw(9) << "Threads" << std::setw(13) << "Nodes" << std::setw(11) << "TTD (ms)"
+          << std::setw(11) << "NPS" << std::setw(10) << "Speedup" << std::setw(12) << "Efficiency"
+          << std::setw(13) << "TTD speedup";
+
+    json << std::fixed << std::setprecision(3) << "{\n  \"depth\": " << std::max(depth, 1)
+         << ",\n  \"positions\": " << positions << ",\n  \"hardwareThreads\": " << hardwareThreads
+         << ",\n  \"runs\": [";
+
+    for (size_t i = 0; i < runs.size(); ++i)
+    {
+        // Each hash size is compared with the first thread count of its own runs
+        const Run&     r    = runs[i];
+        const Run&     base = runs[i - i % threadCounts.size()];
+        const uint64_t nps  = 1000 * r.nodes / r.time;
+        const double   speedup =
+          double(nps) / std::max(1000 * base.nodes / base.time, uint64_t(1));
+        const double efficiency = speedup * base.threads / r.threads;
+        const double ttdSpeedup = double(base.time) / r.time;
+
+        table << "\n"
+              << std::setw(9) << r.hash << std::setw(9) << r.threads << std::setw(13) << r.nodes
+              << std::setw(11) << r.time << std::setw(11) << nps << std::setw(10) << speedup
+              << std::setw(12) << efficiency << std::setw(13) << ttdSpeedup;
+
+        json << (i ? "," : "") << "\n    {\"hash\": " << r.hash << ", \"threads\": " << r.threads
+             << ", \"nodes\": " << r.nodes << ", \"time\": " << r.time << ", \"nps\": " << nps
+             << ", \"speedup\": " << speedup << ", \"efficiency\": " << efficiency
+             << ", \"ttdSpeedup\": " << ttdSpeedup << "}";
+    }
+
+    std::cerr << table.str() << std::endl;
+
+    sync_cout << json.str() << "\n  ]\n}" << sync_endl;
+}
+
 void UCI::search_clear() {
     threads.main_thread()->wait_for_search_finished();
 
     tt.clear(options["Threads"]);
     threads.clear();
-    Tablebases::init(options["SyzygyPath"]);  // Free mapped files
+    Tablebases::init(options["SyzygyPath"], false);  // Free mapped files
+}
+
+// Installs the nets that finished loading in the background after a change of
+// EvalFile or EvalFileSmall. This waits for a running search to finish, so that
+// no evaluation uses the old net any more, and marks the accumulators in the
+// states of the current position, computed with the old net, for a refresh.
+void UCI::swap_networks(Position& pos) {
+
+    threads.main_thread()->wait_for_search_finished();
+
+    bool big   = networks.big.swap_pending();
+    bool small = networks.small.swap_pending();
+
+    for (StateInfo* st = pos.state(); (big || small) && st; st = st->previous)
+    {
+        for (Color c : {WHITE, BLACK})
+        {
+            if (big)
+                st->accumulatorBig.computed[c] = st->accumulatorBig.computedPSQT[c] = false;
+
+            if (small)
+                st->accumulatorSmall.computed[c] = st->accumulatorSmall.computedPSQT[c] = false;
+        }
+    }
 }
 
 void UCI::setoption(std::istringstream& is) {
@@ -684,21 +1537,30 @@ int win_rate_model(Value v, const Position& pos) {
 }
 
 std::string UCI::to_score(Value v, const Position& pos) {
-    assert(-VALUE_INFINITE < v && v < VALUE_INFINITE);
+    std::string s;
+    append_score(s, v, pos);
+    return s;
+}
 
-    std::stringstream ss;
+void UCI::append_score(std::string& out, Value v, const Position& pos) {
+    assert(-VALUE_INFINITE < v && v < VALUE_INFINITE);
 
     if (std::abs(v) < VALUE_TB_WIN_IN_MAX_PLY)
-        ss << "cp " << to_cp(v, pos);
+    {
+        out += "cp ";
+        append_number(out, to_cp(v, pos));
+    }
     else if (std::abs(v) <= VALUE_TB)
     {
         const int ply = VALUE_TB - std::abs(v);  // recompute ss->ply
-        ss << "cp " << (v > 0 ? 20000 - ply : -20000 + ply);
+        out += "cp ";
+        append_number(out, v > 0 ? 20000 - ply : -20000 + ply);
     }
     else
-        ss << "mate " << (v > 0 ? VALUE_MATE - v + 1 : -VALUE_MATE - v) / 2;
-
-    return ss.str();
+    {
+        out += "mate ";
+        append_number(out, (v > 0 ? VALUE_MATE - v + 1 : -VALUE_MATE - v) / 2);
+    }
 }
 
 // Turns a Value to an integer centipawn number,
@@ -715,14 +1577,22 @@ int UCI::to_cp(Value v, const Position& pos) {
 }
 
 std::string UCI::wdl(Value v, const Position& pos) {
-    std::stringstream ss;
+    std::string s;
+    append_wdl(s, v, pos);
+    return s;
+}
 
+void UCI::append_wdl(std::string& out, Value v, const Position& pos) {
     int wdl_w = win_rate_model(v, pos);
     int wdl_l = win_rate_model(-v, pos);
     int wdl_d = 1000 - wdl_w - wdl_l;
-    ss << " wdl " << wdl_w << " " << wdl_d << " " << wdl_l;
 
-    return ss.str();
+    out += " wdl ";
+    append_number(out, wdl_w);
+    out += ' ';
+    append_number(out, wdl_d);
+    out += ' ';
+    append_number(out, wdl_l);
 }
 
 std::string UCI::square(Square s) {
@@ -730,11 +1600,23 @@ std::string UCI::square(Square s) {
 }
 
 std::string UCI::move(Move m, bool chess960) {
+    std::string s;
+    append_move(s, m, chess960);
+    return s;
+}
+
+void UCI::append_move(std::string& out, Move m, bool chess960) {
     if (m == Move::none())
-        return "(none)";
+    {
+        out += "(none)";
+        return;
+    }
 
     if (m == Move::null())
-        return "0000";
+    {
+        out += "0000";
+        return;
+    }
 
     Square from = m.from_sq();
     Square to   = m.to_sq();
@@ -742,12 +1624,11 @@ std::string UCI::move(Move m, bool chess960) {
     if (m.type_of() == CASTLING && !chess960)
         to = make_square(to > from ? FILE_G : FILE_C, rank_of(from));
 
-    std::string move = square(from) + square(to);       
-
-    if (m.type_of() == PROMOTION)
-        move += " pnbrqk"[m.promotion_type()];
+    const char buf[] = {char('a' + file_of(from)), char('1' + rank_of(from)),
+                        char('a' + file_of(to)), char('1' + rank_of(to)),
+                        " pnbrqk"[m.type_of() == PROMOTION ? m.promotion_type() : 0]};
 
-    return move;
+    out.append(buf, m.type_of() == PROMOTION ? 5 : 4);
 }
 
 
@@ -19,6 +19,8 @@
 #ifndef UCI_H_INCLUDED
 #define UCI_H_INCLUDED
 
+#include <charconv>
+#include <functional>
 #include <iostream>
 #include <string>
 
@@ -49,6 +51,18 @@ class UCI {
     static std::string wdl(Value v, const Position& pos);
     static Move        to_move(const Position& pos, std::string& str);
 
+    // Same as above but appending to a caller owned buffer, so that hot output
+    // paths can keep reusing its capacity instead of allocating every time.
+    static void append_score(std::string& out, Value v, const Position& pos);
+    static void append_move(std::string& out, Move m, bool chess960);
+    static void append_wdl(std::string& out, Value v, const Position& pos);
+
+    template<typename T>
+    static void append_number(std::string& out, T n) {
+        char buf[24];
+        out.append(buf, std::to_chars(buf, buf + sizeof(buf), n).ptr);
+    }
+
     static Search::LimitsType parse_limits(const Position& pos, std::istream& is);
 
     const std::string& working_directory() const { return cli.workingDirectory; }
@@ -63,11 +77,23 @@ class UCI {
 
     void go(Position& pos, std::istringstream& is, StateListPtr& states);
     void bench(Position& pos, std::istream& args, StateListPtr& states);
+    void fixed_bench(const std::vector<std::string>& list);
     void position(Position& pos, std::istringstream& is, StateListPtr& states);
     void trace_eval(Position& pos);
+    void evalbatch();
+    void analyse(std::istringstream& is);
+    void scaling(Position& pos, std::istringstream& is);
     void search_clear();
+    void swap_networks(Position& pos);
     void setoption(std::istringstream& is);
     void cs433_project(Stockfish::Position &pos, Stockfish::StateListPtr &states);
+
+    // Runs a job on each of several private thread pools at once
+    TimePoint run_pools(size_t                                          count,
+                        size_t                                          poolSize,
+                        size_t                                          hashMB,
+                        bool                                            sharedHash,
+                        const std::function<void(size_t, ThreadPool&)>& job);
 };
 
 }  // namespace Stockfish
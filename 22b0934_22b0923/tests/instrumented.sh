@@ -78,6 +78,16 @@ rnbqkb1r/ppp1pp2/5n1p/3p2p1/P2PP3/5P2/1PP3PP/RNBQKBNR w KQkq - 0 3
 r4rk1/1b2ppbp/pq4pn/2pp1PB1/1p2P3/1P1P1NN1/1PP3PP/R2Q1RK1 w - - 0 13
 EOF
 
+# malformed FENs, which evalbatch must report as invalid
+cat << EOF > invalid_tmp.epd
+4k3/8/8/8/8/8/8/4K3 w KQkq - 0 1
+r3k2r/8/8/8/8/8/8/R3K2R w Kkq e6 0 1
+r3k2r/8/8/8/8/8/8/4K2R w HAha - 0 1
+rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP w KQkq - 0 1
+rnbqkbnr/pppppppp/9/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1
+rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR x KQkq - 0 1
+EOF
+
 # simple command line testing
 for args in "eval" \
             "go nodes 1000" \
@@ -92,6 +102,11 @@ for args in "eval" \
             "go nodes 20000 searchmoves e2e4 d2d4" \
             "bench 128 $threads 8 default depth" \
             "bench 128 $threads 3 bench_tmp.epd depth" \
+            "bench 16 $threads 3 bench_tmp.epd depth json perf" \
+            "evalbatch < bench_tmp.epd" \
+            "evalbatch < invalid_tmp.epd" \
+            "analyse bench_tmp.epd depth 6" \
+            "microbench 1 10 bench_tmp.epd" \
             "export_net verify.nnue" \
             "d" \
             "compiler" \
@@ -104,6 +119,13 @@ do
 
 done
 
+# verify that every malformed FEN is reported as invalid
+invalid=`./stockfish evalbatch < invalid_tmp.epd | grep -c " invalid$"`
+if [ "$invalid" != 6 ]; then
+   echo "evalbatch reported $invalid of 6 malformed FENs as invalid"
+   false
+fi
+
 # verify the generated net equals the base net
 network=`./stockfish uci | grep 'option name EvalFile type string default' | awk '{print $NF}'`
 echo "Comparing $network to the written verify.nnue"
@@ -176,10 +198,16 @@ cat << EOF > syzygy.exp
  send "setoption name SyzygyPath value ../tests/syzygy/\n"
  expect "info string Found 35 tablebases" {} timeout {exit 1}
  send "bench 128 1 8 default depth\n"
+ send "tbstats reset\n"
  send "ucinewgame\n"
  send "position fen 4k3/PP6/8/8/8/8/8/4K3 w - - 0 1\n"
  send "go depth 5\n"
  expect "bestmove"
+ send "setoption name SyzygyAsyncProbe value true\n"
+ send "position fen 4k3/PP6/8/8/8/8/8/4K3 w - - 0 1\n"
+ send "go depth 5\n"
+ expect "bestmove"
+ send "tbstats\n"
  send "position fen 8/1P6/2B5/8/4K3/8/6k1/8 w - - 0 1\n"
  send "go depth 5\n"
  expect "bestmove"
@@ -201,6 +229,6 @@ do
 
 done
 
-rm -f tsan.supp bench_tmp.epd
+rm -f tsan.supp bench_tmp.epd invalid_tmp.epd
 
 echo "instrumented testing OK"
@@ -0,0 +1,42 @@
+#!/bin/bash
+# measure the ucinewgame -> readyok latency, for the given thread counts
+# usage: ./newgame.sh [threads ...]
+
+error()
+{
+  echo "newgame latency testing failed on line $1"
+  exit 1
+}
+trap 'error ${LINENO}' ERR
+
+echo "newgame latency testing started"
+
+rounds=20
+
+for threads in ${@:-1 8 32}
+do
+  coproc SF { ./stockfish; }
+
+  echo "setoption name Threads value $threads" >&${SF[1]}
+  echo "isready" >&${SF[1]}
+  while read -u ${SF[0]} line && [ "$line" != "readyok" ]; do :; done
+
+  samples=()
+  for i in $(seq $rounds)
+  do
+    start=$(date +%s%N)
+    echo "ucinewgame" >&${SF[1]}
+    echo "isready" >&${SF[1]}
+    while read -u ${SF[0]} line && [ "$line" != "readyok" ]; do :; done
+    samples+=($(($(date +%s%N) - start)))
+  done
+
+  echo "quit" >&${SF[1]}
+  wait $SF_PID
+
+  # median of the samples, in ms
+  median=$(printf '%s\n' "${samples[@]}" | sort -n | sed -n "$((rounds / 2 + 1))p")
+  echo "Threads $threads: median $(awk "BEGIN { printf \"%.1f\", $median / 1e6 }") ms"
+done
+
+echo "newgame latency testing OK"